@@ -0,0 +1,112 @@
+#include "analyze.h"
+
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "game_state.h"
+#include "tokens.h"
+
+namespace Dagor::Analyze {
+
+/// @brief Hands out input lines to the workers and writes their results
+/// back in input order.
+class Scheduler {
+ private:
+  std::istream &in;
+  std::ostream &out;
+  std::mutex inputMutex;
+  std::mutex outputMutex;
+  std::size_t read;
+  std::size_t written;
+  /// @brief Results that are done, but wait for an earlier one.
+  std::map<std::size_t, std::string> pending;
+
+ public:
+  Scheduler(std::istream &in, std::ostream &out)
+      : in{in},
+        out{out},
+        inputMutex(),
+        outputMutex(),
+        read{0},
+        written{0},
+        pending() {}
+
+  /// @brief Reads the next non-empty line into `line`.
+  /// @return its index, or `false` at the end of the input.
+  bool next(std::string &line, std::size_t &index) {
+    std::lock_guard<std::mutex> lock{inputMutex};
+    while (std::getline(in, line)) {
+      if (!Tokenizer{line}.done()) {
+        index = read++;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void finish(std::size_t index, std::string result) {
+    std::lock_guard<std::mutex> lock{outputMutex};
+    pending.emplace(index, std::move(result));
+    for (auto it = pending.begin();
+         it != pending.end() && it->first == written;
+         it = pending.erase(it)) {
+      out << it->second << '\n';
+      written++;
+    }
+    out.flush();
+  }
+};
+
+/// @return the board, side to move, castling rights and en passant square
+/// of an EPD record, without the operations that follow them.
+std::string_view positionPart(std::string_view line) {
+  Tokenizer tokens{line};
+  std::string_view first = tokens.next();
+  std::string_view last = first;
+  for (int field = 1; field < 4 && !tokens.done(); field++) {
+    last = tokens.next();
+  }
+  return span(first, last);
+}
+
+std::string analyzeLine(const std::string &line, const Search::Limits &limits) {
+  std::string_view position = positionPart(line);
+  std::ostringstream result;
+  result << position;
+  try {
+    GameState state{line};
+    Search::Result found = Search::search(state, limits);
+    result << " bestmove " << found.bestMove << " score " << found.score
+           << " depth " << found.depth << " nodes " << found.nodes;
+  } catch (const std::invalid_argument &error) {
+    result << " error " << error.what();
+  }
+  return result.str();
+}
+
+void analyze(std::istream &in, std::ostream &out, const Search::Limits &limits,
+             unsigned threads) {
+  Scheduler scheduler{in, out};
+  auto work = [&]() {
+    std::string line;
+    std::size_t index = 0;
+    while (scheduler.next(line, index)) {
+      scheduler.finish(index, analyzeLine(line, limits));
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < threads; i++) {
+    workers.emplace_back(work);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+}  // namespace Dagor::Analyze
@@ -0,0 +1,24 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <istream>
+#include <ostream>
+
+#include "search.h"
+
+namespace Dagor::Analyze {
+
+/// @brief Searches every position of an EPD (or FEN) stream and writes one
+/// line per position, in input order:
+///
+///     <position> bestmove <move> score <cp> depth <plies> nodes <count>
+///
+/// The positions are handed out to `threads` workers one at a time, each
+/// with its own `GameState` and search context, so a slow position does
+/// not hold up the others. Empty lines are skipped.
+void analyze(std::istream &in, std::ostream &out, const Search::Limits &limits,
+             unsigned threads);
+
+}  // namespace Dagor::Analyze
+
+#endif
@@ -0,0 +1,65 @@
+#include "attacks.h"
+
+#include "game_state.h"
+#include "movetables.h"
+
+namespace Dagor {
+
+BitBoards::BitBoard attacksFrom(Piece::t piece, Square::t square,
+                                BitBoards::BitBoard occupancy) {
+  switch (piece) {
+    case Piece::knight:
+      return MoveTables::knightMoves(square);
+    case Piece::bishop:
+      return MoveTables::bishopHashes[square].lookUp(occupancy);
+    case Piece::rook:
+      return MoveTables::rookHashes[square].lookUp(occupancy);
+    case Piece::queen:
+      return MoveTables::bishopHashes[square].lookUp(occupancy) |
+             MoveTables::rookHashes[square].lookUp(occupancy);
+    case Piece::king:
+      return MoveTables::kingMoves(square);
+    default:
+      return {};
+  }
+}
+
+void AttackMap::compute(const GameState &state) {
+  for (Color::t color : Color::all) {
+    BitBoards::BitBoard pawns = state.forPiece(Piece::pawn, color);
+    byPiece[color][Piece::pawn] = BitBoards::pawnAttacks(color, pawns);
+    twice[color] = BitBoards::pawnAttacks(
+                       color, pawns & ~BitBoards::wholeFile(Coord::a)) &
+                   BitBoards::pawnAttacks(
+                       color, pawns & ~BitBoards::wholeFile(Coord::h));
+    byColor[color] = byPiece[color][Piece::pawn];
+    mobility[color][Piece::pawn] = 0;
+  }
+
+  for (Color::t color : Color::all) {
+    BitBoards::BitBoard occupancy = state.occupancy();
+    if (color == state.them()) {
+      occupancy &= ~state.forPiece(Piece::king, state.us());
+    }
+    BitBoards::BitBoard safe =
+        ~state.forColor(color) &
+        ~byPiece[Color::opponent(color)][Piece::pawn];
+
+    for (Piece::t piece : {Piece::knight, Piece::bishop, Piece::rook,
+                           Piece::queen, Piece::king}) {
+      BitBoards::BitBoard all{};
+      int reached = 0;
+      for (Square::t square : state.forPiece(piece, color)) {
+        BitBoards::BitBoard attacks = attacksFrom(piece, square, occupancy);
+        twice[color] |= byColor[color] & attacks;
+        byColor[color] |= attacks;
+        all |= attacks;
+        reached += (attacks & safe).populationCount();
+      }
+      byPiece[color][piece] = all;
+      mobility[color][piece] = reached;
+    }
+  }
+}
+
+}  // namespace Dagor
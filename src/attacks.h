@@ -0,0 +1,38 @@
+#ifndef ATTACKS_H
+#define ATTACKS_H
+
+#include <array>
+
+#include "bitboard.h"
+#include "types.h"
+
+namespace Dagor {
+
+class GameState;
+
+/// @brief All squares attacked in a position, by color and piece type. It is
+/// computed at most once per position and then shared by move generation, the
+/// evaluation and the static exchange evaluation.
+///
+/// The sliders of the side that is not to move look through the king of the
+/// side to move, so that the king cannot step back along a checking ray.
+struct AttackMap {
+  /// @brief Access: `byPiece[color][piece]`.
+  std::array<std::array<BitBoards::BitBoard, Piece::all.size()>, Color::size>
+      byPiece;
+  std::array<BitBoards::BitBoard, Color::size> byColor;
+  /// @brief Squares attacked by at least two pieces of a color.
+  std::array<BitBoards::BitBoard, Color::size> twice;
+  /// @brief For each piece type, the total number of squares its pieces reach
+  /// that are neither occupied by their own side nor attacked by an opposing
+  /// pawn. Access: `mobility[color][piece]`.
+  std::array<std::array<int, Piece::all.size()>, Color::size> mobility;
+
+  AttackMap() : byPiece{}, byColor{}, twice{}, mobility{} {}
+
+  void compute(const GameState &state);
+};
+
+}  // namespace Dagor
+
+#endif
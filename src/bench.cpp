@@ -0,0 +1,181 @@
+#include "bench.h"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "bitbase.h"
+#include "eval.h"
+#include "game_state.h"
+#include "nnue.h"
+#include "packed.h"
+#include "search.h"
+
+namespace Dagor::Bench {
+
+/// @brief Positions from the perft test suite, chosen for their many
+/// different kinds of moves.
+constexpr std::array<std::string_view, 5> positions = {
+    "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+    "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+    "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+    "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+    "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+};
+
+template <typename Evaluation>
+void measureEval(std::ostream &out, std::string_view name, int rounds,
+                 Evaluation evaluation) {
+  std::uint64_t evaluations = 0;
+  std::int64_t checksum = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::string_view fen : positions) {
+    GameState state{fen};
+    auto moves = state.generateLegalMoves();
+    // A search starts from a position whose accumulator is known, too.
+    checksum += evaluation(state);
+    for (int i = 0; i < rounds; i++) {
+      for (Move m : moves) {
+        state.executeMove(m);
+        checksum += evaluation(state);
+        state.undoMove();
+      }
+    }
+    evaluations += rounds * moves.size();
+  }
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+
+  out << name << ": " << evaluations << " evaluations in " << seconds.count()
+      << " s, " << static_cast<std::uint64_t>(evaluations / seconds.count())
+      << " per second, " << (1e9 * seconds.count() / evaluations)
+      << " ns each (checksum " << checksum << ")\n";
+}
+
+void eval(std::ostream &out, int rounds) {
+  measureEval(out, "handcrafted", rounds, Eval::handcrafted);
+  if (NNUE::isLoaded()) {
+    measureEval(out, "network", rounds, [](const GameState &state) {
+      return state.accumulators.evaluate(state);
+    });
+  }
+}
+
+void search(std::ostream &out, int depth) {
+  std::uint64_t nodes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::string_view fen : positions) {
+    GameState state{fen};
+    Search::Limits limits{};
+    limits.depth = depth;
+    // Each count must not depend on the positions searched before.
+    Search::history().clear();
+    Search::Result result = Search::search(state, limits);
+    out << fen << ": " << result.nodes << " nodes, " << result.time.count()
+        << " ms, bestmove " << result.bestMove << '\n';
+    nodes += result.nodes;
+  }
+  std::chrono::duration<double> seconds =
+      std::chrono::steady_clock::now() - start;
+  out << "depth " << depth << ": " << nodes << " nodes in " << seconds.count()
+      << " s, " << static_cast<std::uint64_t>(nodes / seconds.count())
+      << " per second\n";
+}
+
+/// @brief Reports how many positions per second some work handled.
+void reportPositions(std::ostream &out, std::string_view name,
+                     std::size_t count, std::chrono::duration<double> seconds,
+                     std::uint64_t checksum) {
+  out << name << ": " << count << " positions in " << seconds.count()
+      << " s, " << static_cast<std::uint64_t>(count / seconds.count())
+      << " per second (checksum " << checksum << ")\n";
+}
+
+/// @brief Runs `work` and reports how many positions per second it handled.
+template <typename Work>
+void measurePositions(std::ostream &out, std::string_view name,
+                      std::size_t count, Work work) {
+  auto start = std::chrono::steady_clock::now();
+  std::uint64_t checksum = work();
+  reportPositions(out, name, count, std::chrono::steady_clock::now() - start,
+                  checksum);
+}
+
+bool packed(std::ostream &out, const std::string &path, std::size_t count) {
+  std::vector<Packed::PackedPosition> records;
+  for (std::string_view fen : positions) {
+    GameState state{fen};
+    for (Move m : state.generateLegalMoves()) {
+      state.executeMove(m);
+      records.push_back(Packed::pack(state, 0, Packed::Result::draw, m));
+      state.undoMove();
+    }
+  }
+
+  std::remove(path.c_str());
+  // Timings of records that were not written would mean nothing.
+  auto start = std::chrono::steady_clock::now();
+  bool written = true;
+  {
+    Packed::Writer writer{path};
+    for (std::size_t i = 0; i < count; i++) {
+      written = writer.write(records[i % records.size()]) && written;
+    }
+    written = writer.flush() && written;
+  }
+  if (!written) {
+    out << "could not write to " << path << '\n';
+    std::remove(path.c_str());
+    return false;
+  }
+  reportPositions(out, "write", count, std::chrono::steady_clock::now() - start,
+                  0);
+
+  Packed::MappedFile file{};
+  if (!file.open(path)) {
+    out << "could not map " << path << '\n';
+    return false;
+  }
+  measurePositions(out, "read", file.size(), [&]() {
+    std::uint64_t checksum = 0;
+    for (const Packed::PackedPosition &position : file) {
+      checksum += position.occupancy ^ position.flags;
+    }
+    return checksum;
+  });
+  measurePositions(out, "read and unpack", file.size(), [&]() {
+    std::uint64_t checksum = 0;
+    GameState state{};
+    for (const Packed::PackedPosition &position : file) {
+      Packed::unpack(position, state);
+      checksum += state.hash;
+    }
+    return checksum;
+  });
+  std::remove(path.c_str());
+  return true;
+}
+
+void bitbase(std::ostream &out) {
+  unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned threads : {1u, hardware}) {
+    for (Bitbase::Endgame::t endgame :
+         {Bitbase::Endgame::kqk, Bitbase::Endgame::krk}) {
+      std::string name = Bitbase::name(endgame) + ", " +
+                         std::to_string(threads) + " threads";
+      measurePositions(out, name, Bitbase::size(endgame), [&]() {
+        std::uint64_t won = 0;
+        for (std::uint64_t word : Bitbase::generate(endgame, threads)) {
+          won += static_cast<std::uint64_t>(__builtin_popcountll(word));
+        }
+        return won;
+      });
+    }
+    if (threads == hardware) break;
+  }
+}
+
+}  // namespace Dagor::Bench
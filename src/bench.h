@@ -0,0 +1,36 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+namespace Dagor::Bench {
+
+/// @brief Measures the speed of the evaluation at the leaves of a search:
+/// every legal move of a fixed set of positions is made, evaluated and taken
+/// back. The handcrafted evaluation is always measured, the network only if
+/// one is loaded.
+/// @param out where the results are written to.
+/// @param rounds how often the set of positions is repeated.
+void eval(std::ostream &out, int rounds = 20000);
+
+/// @brief Measures the throughput of packed position files: writing `count`
+/// records to `path`, iterating the mapped file, and unpacking every record
+/// into a `GameState`. The file is removed afterwards.
+/// @return `false` if the file could not be written or mapped.
+bool packed(std::ostream &out, const std::string &path,
+            std::size_t count = 10'000'000);
+
+/// @brief Measures nodes-to-depth: searches each of a fixed set of positions
+/// to `depth` and reports the nodes and time it took. Fewer nodes for the
+/// same depth mean better move ordering.
+void search(std::ostream &out, int depth = 5);
+
+/// @brief Measures the retrograde analysis of the 3 piece bitbases, on one
+/// thread and on all hardware threads, in memory.
+void bitbase(std::ostream &out);
+
+}  // namespace Dagor::Bench
+
+#endif
@@ -0,0 +1,486 @@
+#include "bitbase.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#include "movetables.h"
+
+namespace Dagor::Bitbase {
+
+constexpr std::array<char, 4> magic = {'D', 'G', 'B', 'B'};
+constexpr std::uint8_t version = 1;
+constexpr std::size_t headerSize = 16;
+
+/// @brief The pieces of the strong side besides its king.
+constexpr std::array<std::array<Piece::t, 2>, Endgame::all.size()> pieces = {{
+    {Piece::pawn, Piece::empty},
+    {Piece::queen, Piece::empty},
+    {Piece::rook, Piece::empty},
+    {Piece::bishop, Piece::knight},
+}};
+
+int pieceCount(Endgame::t endgame) {
+  return pieces[endgame][1] == Piece::empty ? 1 : 2;
+}
+
+std::string name(Endgame::t endgame) {
+  std::string text = "K";
+  for (int i = 0; i < pieceCount(endgame); i++) {
+    text += Piece::name(pieces[endgame][i], Color::white);
+  }
+  return text + "K";
+}
+
+std::size_t size(Endgame::t endgame) {
+  return std::size_t{2} << (6 * (2 + pieceCount(endgame)));
+}
+
+/// @brief A position from the strong side’s point of view: as if it were
+/// white, so that KPK pawns always move up the board.
+struct Position {
+  /// @brief 0 if the strong side is to move, 1 otherwise.
+  int side;
+  int strongKing;
+  int weakKing;
+  std::array<int, 2> squares;
+};
+
+/// @brief Positions are numbered `side, strongKing, weakKing, squares...`,
+/// six bits each but the side, the last one lowest.
+std::size_t encode(Endgame::t endgame, const Position &p) {
+  std::size_t index = static_cast<std::size_t>(
+      (p.side * Square::size + p.strongKing) * Square::size + p.weakKing);
+  for (int i = 0; i < pieceCount(endgame); i++) {
+    index = index * Square::size + static_cast<std::size_t>(p.squares[i]);
+  }
+  return index;
+}
+
+Position decode(Endgame::t endgame, std::size_t index) {
+  Position p{};
+  for (int i = pieceCount(endgame) - 1; i >= 0; i--) {
+    p.squares[i] = static_cast<int>(index % Square::size);
+    index /= Square::size;
+  }
+  p.weakKing = static_cast<int>(index % Square::size);
+  index /= Square::size;
+  p.strongKing = static_cast<int>(index % Square::size);
+  p.side = static_cast<int>(index / Square::size);
+  return p;
+}
+
+BitBoards::BitBoard attacks(Piece::t piece, int square,
+                            BitBoards::BitBoard occupancy) {
+  auto from = static_cast<Square::t>(square);
+  switch (piece) {
+    case Piece::pawn:
+      return MoveTables::pawnAttacks(Color::white, from);
+    case Piece::knight:
+      return MoveTables::knightMoves(from);
+    case Piece::bishop:
+      return MoveTables::bishopHashes[from].lookUp(occupancy);
+    case Piece::rook:
+      return MoveTables::rookHashes[from].lookUp(occupancy);
+    case Piece::queen:
+      return MoveTables::bishopHashes[from].lookUp(occupancy) |
+             MoveTables::rookHashes[from].lookUp(occupancy);
+    default:
+      return MoveTables::kingMoves(from);
+  }
+}
+
+BitBoards::BitBoard occupancyOf(Endgame::t endgame, const Position &p) {
+  BitBoards::BitBoard occupancy{};
+  occupancy.setSquare(static_cast<Square::t>(p.strongKing));
+  occupancy.setSquare(static_cast<Square::t>(p.weakKing));
+  for (int i = 0; i < pieceCount(endgame); i++) {
+    occupancy.setSquare(static_cast<Square::t>(p.squares[i]));
+  }
+  return occupancy;
+}
+
+/// @brief The squares the strong side attacks, without the piece `except`.
+BitBoards::BitBoard strongAttacks(Endgame::t endgame, const Position &p,
+                                  BitBoards::BitBoard occupancy,
+                                  int except = -1) {
+  BitBoards::BitBoard attacked =
+      MoveTables::kingMoves(static_cast<Square::t>(p.strongKing));
+  for (int i = 0; i < pieceCount(endgame); i++) {
+    if (i != except) {
+      attacked |= attacks(pieces[endgame][i], p.squares[i], occupancy);
+    }
+  }
+  return attacked;
+}
+
+/// @return whether the pieces are on different squares, the kings apart,
+/// pawns off the first and last rank, and the side that just moved not in
+/// check.
+bool isValid(Endgame::t endgame, const Position &p) {
+  BitBoards::BitBoard occupancy = occupancyOf(endgame, p);
+  if (occupancy.populationCount() != 2 + pieceCount(endgame)) return false;
+  if (MoveTables::kingMoves(static_cast<Square::t>(p.strongKing))
+          .isSet(static_cast<Square::t>(p.weakKing))) {
+    return false;
+  }
+  if (endgame == Endgame::kpk &&
+      (p.squares[0] < Coord::width || p.squares[0] >= 7 * Coord::width)) {
+    return false;
+  }
+  return p.side == 1 || !strongAttacks(endgame, p, occupancy)
+                             .isSet(static_cast<Square::t>(p.weakKing));
+}
+
+/// @brief The tables the engine uses, by endgame.
+static std::array<Table, Endgame::all.size()> tables{};
+
+bool Table::open(const std::string &path, Endgame::t endgame) {
+  close();
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+  struct stat status {};
+  std::size_t expected = headerSize + size(endgame) / 8;
+  if (fstat(descriptor, &status) != 0 ||
+      static_cast<std::size_t>(status.st_size) != expected) {
+    ::close(descriptor);
+    return false;
+  }
+  void *address =
+      mmap(nullptr, expected, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  ::close(descriptor);
+  if (address == MAP_FAILED) return false;
+  auto header = static_cast<const unsigned char *>(address);
+  std::uint64_t positions = 0;
+  std::memcpy(&positions, header + 8, sizeof(positions));
+  if (!std::equal(magic.begin(), magic.end(), header) ||
+      header[4] != version || header[5] != endgame ||
+      positions != size(endgame)) {
+    munmap(address, expected);
+    return false;
+  }
+  // Probes jump around the table.
+  madvise(address, expected, MADV_RANDOM);
+  mapped = address;
+  mappedBytes = expected;
+  bits = reinterpret_cast<const std::uint64_t *>(header + headerSize);
+  return true;
+}
+
+void Table::assign(std::vector<std::uint64_t> words) {
+  close();
+  owned = std::move(words);
+  bits = owned.data();
+}
+
+void Table::close() {
+  if (mapped != nullptr) munmap(mapped, mappedBytes);
+  mapped = nullptr;
+  mappedBytes = 0;
+  owned.clear();
+  owned.shrink_to_fit();
+  bits = nullptr;
+}
+
+bool Table::write(const std::string &path, Endgame::t endgame) const {
+  std::ofstream file{path, std::ios::binary};
+  if (!file || !isLoaded()) return false;
+  std::array<char, headerSize> header{};
+  std::copy(magic.begin(), magic.end(), header.begin());
+  header[4] = static_cast<char>(version);
+  header[5] = static_cast<char>(endgame);
+  std::uint64_t positions = size(endgame);
+  std::memcpy(header.data() + 8, &positions, sizeof(positions));
+  file.write(header.data(), headerSize);
+  file.write(reinterpret_cast<const char *>(bits),
+             static_cast<std::streamsize>(size(endgame) / 8));
+  return static_cast<bool>(file);
+}
+
+/// @brief Splits `[0, count)` into one range per thread.
+template <typename Work>
+void inParallel(std::size_t count, unsigned threads, Work work) {
+  threads = std::max(1u, threads);
+  std::size_t chunk = (count + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (unsigned thread = 0; thread < threads; thread++) {
+    std::size_t begin = std::min(count, thread * chunk);
+    std::size_t end = std::min(count, begin + chunk);
+    workers.emplace_back(work, thread, begin, end);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+/// @brief The state of a retrograde analysis. Positions with the weak side
+/// to move count down their moves that do not lose yet; when none is left,
+/// they are lost.
+struct Generator {
+  /// @brief Weak side positions that are drawn or invalid.
+  static constexpr std::uint8_t settled = 0xff;
+
+  Endgame::t endgame;
+  unsigned threads;
+  std::vector<std::atomic<std::uint64_t>> wins;
+  /// @brief Indexed by `index - size / 2`.
+  std::vector<std::atomic<std::uint8_t>> counters;
+
+  Generator(Endgame::t endgame, unsigned threads)
+      : endgame{endgame},
+        threads{std::max(1u, threads)},
+        wins(size(endgame) / 64),
+        counters(size(endgame) / 2) {}
+
+  /// @return `true` if the position was not known to be won before.
+  bool markWin(std::size_t index) {
+    std::uint64_t bit = std::uint64_t{1} << (index & 63);
+    return !(wins[index >> 6].fetch_or(bit, std::memory_order_relaxed) & bit);
+  }
+
+  void initialize(std::size_t begin, std::size_t end,
+                  std::vector<std::uint32_t> &frontier);
+  void retract(std::uint32_t index, std::vector<std::uint32_t> &next);
+  std::vector<std::uint64_t> run();
+};
+
+void Generator::initialize(std::size_t begin, std::size_t end,
+                           std::vector<std::uint32_t> &frontier) {
+  std::size_t half = size(endgame) / 2;
+  for (std::size_t index = begin; index < end; index++) {
+    Position p = decode(endgame, index);
+    if (p.side == 1) {
+      counters[index - half].store(settled, std::memory_order_relaxed);
+    }
+    if (!isValid(endgame, p)) continue;
+    BitBoards::BitBoard occupancy = occupancyOf(endgame, p);
+
+    if (p.side == 1) {
+      auto weakKing = static_cast<Square::t>(p.weakKing);
+      occupancy.unsetSquare(weakKing);
+      BitBoards::BitBoard attacked = strongAttacks(endgame, p, occupancy);
+      BitBoards::BitBoard escapes =
+          MoveTables::kingMoves(weakKing) & ~attacked;
+      if (!(escapes & occupancy).isEmpty()) {
+        // Taking an undefended piece draws.
+        continue;
+      } else if (!escapes.isEmpty()) {
+        counters[index - half].store(
+            static_cast<std::uint8_t>(escapes.populationCount()),
+            std::memory_order_relaxed);
+      } else if (attacked.isSet(weakKing)) {
+        markWin(index);
+        frontier.push_back(static_cast<std::uint32_t>(index));
+      }
+      continue;
+    }
+
+    // A pawn that promotes into a won position wins.
+    int ahead = p.squares[0] + Coord::width;
+    if (endgame == Endgame::kpk && ahead >= 7 * Coord::width &&
+        !occupancy.isSet(static_cast<Square::t>(ahead))) {
+      for (Endgame::t promoted : {Endgame::kqk, Endgame::krk}) {
+        Position after = p;
+        after.side = 1;
+        after.squares[0] = ahead;
+        if (tables[promoted].isWin(encode(promoted, after))) {
+          markWin(index);
+          frontier.push_back(static_cast<std::uint32_t>(index));
+          break;
+        }
+      }
+    }
+  }
+}
+
+/// @brief Goes one move back from a won position.
+void Generator::retract(std::uint32_t index,
+                        std::vector<std::uint32_t> &next) {
+  Position p = decode(endgame, index);
+  BitBoards::BitBoard occupancy = occupancyOf(endgame, p);
+  std::size_t half = size(endgame) / 2;
+
+  if (p.side == 0) {
+    // The weak side moved into a lost position: one escape less.
+    Position before = p;
+    before.side = 1;
+    for (Square::t from :
+         MoveTables::kingMoves(static_cast<Square::t>(p.weakKing)) &
+             ~occupancy) {
+      before.weakKing = from;
+      if (!isValid(endgame, before)) continue;
+      std::size_t previous = encode(endgame, before);
+      std::atomic<std::uint8_t> &counter = counters[previous - half];
+      if (counter.load(std::memory_order_relaxed) == settled) continue;
+      if (counter.fetch_sub(1, std::memory_order_relaxed) == 1 &&
+          markWin(previous)) {
+        next.push_back(static_cast<std::uint32_t>(previous));
+      }
+    }
+    return;
+  }
+
+  // The strong side moved into a won position: it wins.
+  auto add = [&](const Position &before) {
+    if (!isValid(endgame, before)) return;
+    std::size_t previous = encode(endgame, before);
+    if (markWin(previous)) next.push_back(static_cast<std::uint32_t>(previous));
+  };
+  Position before = p;
+  before.side = 0;
+  for (Square::t from :
+       MoveTables::kingMoves(static_cast<Square::t>(p.strongKing)) &
+           ~occupancy) {
+    before.strongKing = from;
+    add(before);
+  }
+  before.strongKing = p.strongKing;
+  for (int i = 0; i < pieceCount(endgame); i++) {
+    int square = p.squares[i];
+    if (pieces[endgame][i] == Piece::pawn) {
+      int back = square - Coord::width;
+      if (back < Coord::width ||
+          occupancy.isSet(static_cast<Square::t>(back))) {
+        continue;
+      }
+      before.squares[i] = back;
+      add(before);
+      int start = back - Coord::width;
+      if (start / Coord::width == 1 &&
+          !occupancy.isSet(static_cast<Square::t>(start))) {
+        before.squares[i] = start;
+        add(before);
+      }
+    } else {
+      for (Square::t from :
+           attacks(pieces[endgame][i], square, occupancy) & ~occupancy) {
+        before.squares[i] = from;
+        add(before);
+      }
+    }
+    before.squares[i] = square;
+  }
+}
+
+std::vector<std::uint64_t> Generator::run() {
+  std::vector<std::vector<std::uint32_t>> found(threads);
+  inParallel(size(endgame), threads,
+             [&](unsigned thread, std::size_t begin, std::size_t end) {
+               initialize(begin, end, found[thread]);
+             });
+
+  std::vector<std::uint32_t> frontier;
+  for (;;) {
+    frontier.clear();
+    for (auto &part : found) {
+      frontier.insert(frontier.end(), part.begin(), part.end());
+      part.clear();
+    }
+    if (frontier.empty()) break;
+    inParallel(frontier.size(), threads,
+               [&](unsigned thread, std::size_t begin, std::size_t end) {
+                 for (std::size_t i = begin; i < end; i++) {
+                   retract(frontier[i], found[thread]);
+                 }
+               });
+  }
+
+  std::vector<std::uint64_t> words(wins.size());
+  for (std::size_t i = 0; i < words.size(); i++) {
+    words[i] = wins[i].load(std::memory_order_relaxed);
+  }
+  return words;
+}
+
+std::vector<std::uint64_t> generate(Endgame::t endgame, unsigned threads) {
+  if (endgame == Endgame::kpk) {
+    for (Endgame::t promoted : {Endgame::kqk, Endgame::krk}) {
+      if (!tables[promoted].isLoaded()) {
+        tables[promoted].assign(generate(promoted, threads));
+      }
+    }
+  }
+  return Generator{endgame, threads}.run();
+}
+
+std::size_t load(const std::string &directory) {
+  std::size_t loaded = 0;
+  for (Endgame::t endgame : Endgame::all) {
+    loaded += tables[endgame].open(directory + "/" + name(endgame) + ".bb",
+                                   endgame);
+  }
+  if (!tables[Endgame::kpk].isLoaded()) {
+    tables[Endgame::kpk].assign(generate(
+        Endgame::kpk, std::max(1u, std::thread::hardware_concurrency())));
+  }
+  return loaded;
+}
+
+bool probe(const GameState &state, bool &strongWins) {
+  int count = state.occupancy().populationCount();
+  if (count < 3 || count > 4) return false;
+  Color::t strong =
+      state.forColor(Color::white).populationCount() > 1 ? Color::white
+                                                         : Color::black;
+  Color::t weak = Color::opponent(strong);
+  if (state.forColor(weak).populationCount() != 1) return false;
+
+  for (Endgame::t endgame : Endgame::all) {
+    if (pieceCount(endgame) + 2 != count || !tables[endgame].isLoaded()) {
+      continue;
+    }
+    // Tables see the strong side as white.
+    int flip = strong == Color::white ? 0 : 56;
+    Position p{};
+    p.side = state.us() == strong ? 0 : 1;
+    p.strongKing = state.forPiece(Piece::king, strong).findFirstSet() ^ flip;
+    p.weakKing = state.forPiece(Piece::king, weak).findFirstSet() ^ flip;
+    bool matches = true;
+    for (int i = 0; i < pieceCount(endgame) && matches; i++) {
+      BitBoards::BitBoard found = state.forPiece(pieces[endgame][i], strong);
+      matches = found.populationCount() == 1;
+      p.squares[i] = found.findFirstSet() ^ flip;
+    }
+    if (!matches) continue;
+    strongWins = tables[endgame].isWin(encode(endgame, p));
+    return true;
+  }
+  return false;
+}
+
+bool run(const std::string &directory, unsigned threads, std::ostream &out) {
+  // KQK and KRK come first, KPK promotes into them.
+  for (Endgame::t endgame :
+       {Endgame::kqk, Endgame::krk, Endgame::kpk, Endgame::kbnk}) {
+    auto start = std::chrono::steady_clock::now();
+    tables[endgame].assign(generate(endgame, threads));
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    std::string path = directory + "/" + name(endgame) + ".bb";
+    if (!tables[endgame].write(path, endgame)) {
+      out << "could not write " << path << "\n";
+      return false;
+    }
+    std::uint64_t won = 0;
+    for (std::size_t i = 0; i < size(endgame); i++) {
+      won += tables[endgame].isWin(i);
+    }
+    out << name(endgame) << ": " << size(endgame) << " positions, " << won
+        << " won, " << seconds.count() << " s on " << threads
+        << " threads, " << static_cast<std::uint64_t>(size(endgame) /
+                                                        seconds.count())
+        << " per second\n";
+    out.flush();
+  }
+  return true;
+}
+
+}  // namespace Dagor::Bitbase
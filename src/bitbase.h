@@ -0,0 +1,85 @@
+#ifndef BITBASE_H
+#define BITBASE_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "game_state.h"
+
+/// @brief Win/draw tables of the small endgames in which a king and some
+/// pieces face a bare king, computed by the engine itself (`gen-bitbase`).
+/// The weak side can never win, so one bit per position is enough: set if
+/// the side with the pieces wins.
+namespace Dagor::Bitbase {
+
+namespace Endgame {
+using t = std::uint8_t;
+enum { kpk, kqk, krk, kbnk };
+constexpr std::array<t, 4> all = {kpk, kqk, krk, kbnk};
+}  // namespace Endgame
+
+/// @return the name of an endgame, like `KPK`.
+std::string name(Endgame::t endgame);
+
+/// @return the number of positions of an endgame’s table, valid or not.
+std::size_t size(Endgame::t endgame);
+
+/// @brief The bits of a table: either computed in memory, or a file mapped
+/// as it is. Files are a 16 byte header (`DGBB`, a version, the endgame and
+/// the number of positions) and then the bits as little endian words.
+class Table {
+ private:
+  std::vector<std::uint64_t> owned;
+  const std::uint64_t *bits;
+  void *mapped;
+  std::size_t mappedBytes;
+
+ public:
+  Table() : owned(), bits{nullptr}, mapped{nullptr}, mappedBytes{0} {}
+  Table(const Table &) = delete;
+  Table &operator=(const Table &) = delete;
+  ~Table() { close(); }
+
+  /// @return `true` if the file could be mapped and is a table of
+  /// `endgame`.
+  bool open(const std::string &path, Endgame::t endgame);
+  void assign(std::vector<std::uint64_t> words);
+  void close();
+  /// @return `false` if the file could not be written.
+  bool write(const std::string &path, Endgame::t endgame) const;
+
+  bool isLoaded() const { return bits != nullptr; }
+  bool isWin(std::size_t index) const {
+    return bits[index >> 6] >> (index & 63) & 1;
+  }
+};
+
+/// @brief Computes the table of an endgame by retrograde analysis on
+/// `threads` threads: starting from the mates, each round marks the
+/// positions one move further away from a won one. KPK needs the tables of
+/// KQK and KRK for the promotions; they are computed first if they are not
+/// loaded.
+/// @return the bits of the table.
+std::vector<std::uint64_t> generate(Endgame::t endgame, unsigned threads);
+
+/// @brief Maps the tables in `directory`, and computes KPK in memory if
+/// there is no file for it. Earlier tables are forgotten.
+/// @return the number of tables loaded from files.
+std::size_t load(const std::string &directory);
+
+/// @brief Looks a position up. The weak side must have a bare king.
+/// @return `false` if no table covers it. Otherwise `strongWins` tells
+/// whether the side with the pieces wins.
+bool probe(const GameState &state, bool &strongWins);
+
+/// @brief Computes all tables, writes them to `directory` as `KPK.bb` and
+/// so on, and reports the time each took to `out`.
+/// @return `false` if a file could not be written.
+bool run(const std::string &directory, unsigned threads, std::ostream &out);
+
+}  // namespace Dagor::Bitbase
+
+#endif
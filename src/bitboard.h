@@ -208,6 +208,20 @@ inline BitBoard below(Coord::t rank) {
   return {shiftRight(1, rank * Coord::width) - 1};
 }
 
+/// @brief Computes all squares attacked by a set of pawns at once.
+/// @param color the color of the pawns.
+/// @param pawns the squares of the pawns.
+/// @return a bitboard with all attacked squares set.
+inline BitBoard pawnAttacks(Color::t color, BitBoard pawns) {
+  std::uint64_t towardsA = (pawns & ~wholeFile(Coord::a)).asUint();
+  std::uint64_t towardsH = (pawns & ~wholeFile(Coord::h)).asUint();
+  if (color == Color::white) {
+    return {(towardsA << 7) | (towardsH << 9)};
+  } else {
+    return {(towardsA >> 9) | (towardsH >> 7)};
+  }
+}
+
 /// @brief A bitboard containing all squares adjacent to one of the edges of
 /// the board.
 ///
@@ -0,0 +1,53 @@
+#ifndef BOOK_H
+#define BOOK_H
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "game_state.h"
+
+/// @brief Opening books in the Polyglot format: files of 16 byte entries
+/// (key, move, weight and learning data, all big endian), sorted by key.
+namespace Dagor::Book {
+
+/// @brief The Polyglot hash of a position. It uses its own fixed table of
+/// random numbers, unlike `GameState::hash`, and counts an en passant
+/// square only if a pawn can actually capture there.
+std::uint64_t key(const GameState &state);
+
+/// @brief A book file, mapped into memory and searched in place.
+class Book {
+ private:
+  const unsigned char *first;
+  std::size_t count;
+  std::size_t mappedBytes;
+
+ public:
+  Book() : first{nullptr}, count{0}, mappedBytes{0} {}
+  Book(const Book &) = delete;
+  Book &operator=(const Book &) = delete;
+  ~Book() { close(); }
+
+  /// @return `true` if the file could be mapped.
+  bool open(const std::string &path);
+  void close();
+
+  bool isOpen() const { return first != nullptr; }
+  std::size_t size() const { return count; }
+
+  /// @return the legal book moves of a position with their weights.
+  std::vector<std::pair<Move, std::uint16_t>> moves(
+      const GameState &state) const;
+
+  /// @brief Picks one of the book moves, each with a probability
+  /// proportional to its weight.
+  /// @return the move, or `nullMove` if the position is not in the book.
+  Move pick(const GameState &state, std::mt19937_64 &generator) const;
+};
+
+}  // namespace Dagor::Book
+
+#endif
@@ -0,0 +1,131 @@
+#include "datagen.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "game_state.h"
+#include "packed.h"
+#include "search.h"
+
+namespace Dagor::Datagen {
+
+/// @brief Games that are still going after this many plies are drawn.
+constexpr int maxPlies = 400;
+/// @brief How often the progress is reported.
+constexpr std::chrono::seconds reportInterval{10};
+
+Packed::Result::t winFor(Color::t color) {
+  return color == Color::white ? Packed::Result::whiteWins
+                               : Packed::Result::blackWins;
+}
+
+/// @brief Plays one game and collects its quiet positions in `records`.
+/// @return the result of the game.
+Packed::Result::t playGame(const Settings &settings,
+                           std::mt19937_64 &generator,
+                           std::vector<Packed::PackedPosition> &records) {
+  // Like after `ucinewgame`, nothing learned in the last game carries over.
+  Search::history().clear();
+  GameState state{};
+  for (int i = 0; i < settings.randomPlies; i++) {
+    Move move = Search::random(state, generator);
+    if (move == nullMove) return Packed::Result::draw;
+    state.executeMove(move);
+  }
+
+  Search::Limits limits{};
+  limits.nodes = settings.nodes;
+  for (int ply = 0;; ply++) {
+    if (state.uneventfulHalfMoves >= 100 || ply >= maxPlies ||
+        state.hasInsufficientMaterial() || state.repetitions() >= 2) {
+      return Packed::Result::draw;
+    }
+
+    Search::Result found = Search::search(state, limits);
+    if (found.bestMove == nullMove) {
+      if (found.score < 0) return winFor(state.them());
+      return Packed::Result::draw;
+    } else if (std::abs(found.score) >= Search::mate - Search::maxDepth) {
+      // The rest of the game is a forced mate.
+      return found.score > 0 ? winFor(state.us()) : winFor(state.them());
+    }
+
+    bool quiet = found.depth > 0 && !state.isCheck() &&
+                 !state.isCapture(found.bestMove) &&
+                 found.bestMove.promotion == Piece::empty;
+    if (quiet) {
+      int score = state.us() == Color::white ? found.score : -found.score;
+      records.push_back(Packed::pack(state, static_cast<std::int16_t>(score),
+                                     Packed::Result::draw, found.bestMove));
+    }
+    state.executeMove(found.bestMove);
+  }
+}
+
+std::uint64_t run(const Settings &settings, std::ostream &out) {
+  std::atomic<unsigned> nextGame{0};
+  std::atomic<unsigned> running{settings.threads};
+  std::atomic<std::uint64_t> positions{0};
+  // Set once a block could not be written; all threads stop then.
+  std::atomic<bool> failed{false};
+
+  auto worker = [&](unsigned thread) {
+    std::mt19937_64 generator{settings.seed + thread};
+    Packed::Writer writer{settings.output};
+    std::vector<Packed::PackedPosition> records;
+    bool written = writer.isOpen();
+    while (written && !failed && nextGame++ < settings.games) {
+      records.clear();
+      Packed::Result::t result = playGame(settings, generator, records);
+      for (Packed::PackedPosition &record : records) {
+        record.result = result;
+        written = writer.write(record) && written;
+      }
+      positions.fetch_add(records.size(), std::memory_order_relaxed);
+    }
+    if (!writer.flush() || !written) failed = true;
+    running--;
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  auto report = [&]() {
+    std::chrono::duration<double> seconds =
+        std::chrono::steady_clock::now() - start;
+    std::uint64_t count = positions.load();
+    out << count << " positions from "
+        << std::min(nextGame.load(), settings.games) << " games in "
+        << seconds.count() << " s, "
+        << static_cast<std::uint64_t>(count / seconds.count())
+        << " positions per second\n";
+    out.flush();
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < settings.threads; i++) {
+    workers.emplace_back(worker, i);
+  }
+  auto nextReport = start + reportInterval;
+  while (running > 0) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{100});
+    if (std::chrono::steady_clock::now() >= nextReport) {
+      report();
+      nextReport += reportInterval;
+    }
+  }
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+  report();
+  if (failed) {
+    out << "could not write to " << settings.output << '\n';
+    return 0;
+  }
+  return positions;
+}
+
+}  // namespace Dagor::Datagen
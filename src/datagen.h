@@ -0,0 +1,37 @@
+#ifndef DATAGEN_H
+#define DATAGEN_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// @brief Generates training positions by self-play.
+namespace Dagor::Datagen {
+
+struct Settings {
+  /// @brief The file the packed positions are appended to.
+  std::string output;
+  unsigned games;
+  /// @brief The nodes searched for every move.
+  std::uint64_t nodes;
+  unsigned threads;
+  /// @brief Random moves played at the start of every game, so that the
+  /// games differ.
+  int randomPlies;
+  /// @brief Thread `i` draws its random moves from a generator seeded with
+  /// `seed + i`.
+  std::uint64_t seed;
+};
+
+/// @brief Plays `settings.games` games on `settings.threads` threads and
+/// writes the quiet positions (not in check, best move no capture or
+/// promotion) with their scores and the game results. Each thread buffers
+/// its positions and appends them in large blocks, so the threads rarely
+/// wait for each other. Progress and the final rate go to `out`. If a
+/// block cannot be written, all threads stop and `out` is told so.
+/// @return the number of positions written, or 0 if a block could not be.
+std::uint64_t run(const Settings &settings, std::ostream &out);
+
+}  // namespace Dagor::Datagen
+
+#endif
@@ -1,97 +1,159 @@
 #include "eval.h"
 
-#include <array>
-
+#include <algorithm>
+
+#include "attacks.h"
+#include "bitbase.h"
+#include "movetables.h"
+#include "nnue.h"
+#include "pawns.h"
+#include "psqt.h"
 #include "types.h"
 
 namespace Dagor::Eval {
 
-constexpr std::array<std::int8_t, Square::size * Piece::all.size()>
-    opening_table = {
-        /* Pawns */
-        0, 0, 0, 0, 0, 0, 0, 0,          //
-        50, 50, 50, 50, 50, 50, 50, 50,  //
-        10, 10, 20, 30, 30, 20, 10, 10,  //
-        5, 5, 10, 25, 25, 10, 5, 5,      //
-        0, 0, 0, 20, 20, 0, 0, 0,        //
-        5, -5, -10, 0, 0, -10, -5, 5,    //
-        5, 10, 10, -20, -20, 10, 10, 5,  //
-        0, 0, 0, 0, 0, 0, 0, 0,          //
-
-        /* Knights */
-        -50, -40, -30, -30, -30, -30, -40, -50,  //
-        -40, -20, 0, 0, 0, 0, -20, -40,          //
-        -30, 0, 10, 15, 15, 10, 0, -30,          //
-        -30, 5, 15, 20, 20, 15, 5, -30,          //
-        -30, 0, 15, 20, 20, 15, 0, -30,          //
-        -30, 5, 10, 15, 15, 10, 5, -30,          //
-        -40, -20, 0, 5, 5, 0, -20, -40,          //
-        -50, -40, -30, -30, -30, -30, -40, -50,  //
-
-        /* Bishops */
-        -20, -10, -10, -10, -10, -10, -10, -20,  //
-        -10, 0, 0, 0, 0, 0, 0, -10,              //
-        -10, 0, 5, 10, 10, 5, 0, -10,            //
-        -10, 5, 5, 10, 10, 5, 5, -10,            //
-        -10, 0, 10, 10, 10, 10, 0, -10,          //
-        -10, 10, 10, 10, 10, 10, 10, -10,        //
-        -10, 5, 0, 0, 0, 0, 5, -10,              //
-        -20, -10, -10, -10, -10, -10, -10, -20,  //
-
-        /* Rooks */
-        0, 0, 0, 0, 0, 0, 0, 0,        //
-        5, 10, 10, 10, 10, 10, 10, 5,  //
-        -5, 0, 0, 0, 0, 0, 0, -5,      //
-        -5, 0, 0, 0, 0, 0, 0, -5,      //
-        -5, 0, 0, 0, 0, 0, 0, -5,      //
-        -5, 0, 0, 0, 0, 0, 0, -5,      //
-        -5, 0, 0, 0, 0, 0, 0, -5,      //
-        0, 0, 0, 5, 5, 0, 0, 0,        //
-
-        /* Queen */
-        -20, -10, -10, -5, -5, -10, -10, -20,  //
-        -10, 0, 0, 0, 0, 0, 0, -10,            //
-        -10, 0, 5, 5, 5, 5, 0, -10,            //
-        -5, 0, 5, 5, 5, 5, 0, -5,              //
-        0, 0, 5, 5, 5, 5, 0, -5,               //
-        -10, 5, 5, 5, 5, 5, 0, -10,            //
-        -10, 0, 5, 0, 0, 0, 0, -10,            //
-        -20, -10, -10, -5, -5, -10, -10, -20,  //
-
-        /* King */
-        -30, -40, -40, -50, -50, -40, -40, -30,  //
-        -30, -40, -40, -50, -50, -40, -40, -30,  //
-        -30, -40, -40, -50, -50, -40, -40, -30,  //
-        -30, -40, -40, -50, -50, -40, -40, -30,  //
-        -20, -30, -30, -40, -40, -30, -30, -20,  //
-        -10, -20, -20, -20, -20, -20, -20, -10,  //
-        20, 20, 0, 0, 0, 0, 20, 20,              //
-        20, 30, 10, 0, 0, 10, 30, 20,            //
-};
+/// @brief Bonus per safe square a piece can reach.
+constexpr std::array<Score::t, Piece::all.size()> mobilityBonus = {
+    Score::make(0, 0), Score::make(4, 4), Score::make(5, 5),
+    Score::make(2, 4), Score::make(1, 2), Score::make(0, 0)};
+/// @brief How dangerous an attack on the squares around a king is, by the
+/// type of the attacker.
+constexpr std::array<int, Piece::all.size()> kingAttackWeight = {0, 2, 2, 3, 5,
+                                                                 0};
+constexpr int maxKingDanger = 500;
 
 int eval(const GameState& state) {
-  int result = 0;
+  if (state.uneventfulHalfMoves >= 50) {
+    return 0;
+  }
+  bool strongWins;
+  if (Bitbase::probe(state, strongWins)) {
+    return bitbaseScore(state, strongWins);
+  }
 
-  for (Piece::t piece : Piece::nonKing) {
-    BitBoards::BitBoard ourPieces = state.forPiece(piece, state.us());
-    BitBoards::BitBoard opponentPieces = state.forPiece(piece, state.them());
+  if (NNUE::isLoaded()) {
+    return state.accumulators.evaluate(state);
+  }
+  return handcrafted(state);
+}
 
-    /* Material */
-    int diff = ourPieces.populationCount() - opponentPieces.populationCount();
-    result += diff * Piece::worth[piece];
+int handcrafted(const GameState& state) {
+  /* Material and positions, maintained incrementally by the game state */
+  Score::t score = state.pieceSquareScore;
+
+  /* Pawn structure and king shelter, cached by pawn key */
+  const PawnEntry& pawns = pawnTable().probe(state);
+  score += pawns.score;
+  for (Color::t color : Color::all) {
+    Square::t king = state.forPiece(Piece::king, color).findFirstSet();
+    Square::t forWhite = Square::reverseForColor(king, color);
+    if (Square::rank(forWhite) <= 1) {
+      Score::t shelter =
+          Score::make(pawns.shelter[color][Square::file(king)], 0);
+      score += color == Color::white ? shelter : -shelter;
+    }
+  }
+
+  /* Mobility and king safety, from the attack maps */
+  const AttackMap& attacks = state.attacks();
+  for (Color::t color : Color::all) {
+    Color::t opponent = Color::opponent(color);
+    Score::t activity = Score::zero;
+    for (Piece::t piece : Piece::all) {
+      activity += mobilityBonus[piece] * attacks.mobility[color][piece];
+    }
 
-    /* Positions */
-    for (Square::t square : ourPieces) {
-      Square::t forWhite = Square::reverseForColor(square, state.us());
-      result += opening_table[forWhite + piece * Square::size];
+    Square::t king = state.forPiece(Piece::king, color).findFirstSet();
+    BitBoards::BitBoard zone =
+        MoveTables::kingMoves(king) | BitBoards::single(king);
+    int units = 0;
+    for (Piece::t piece : Piece::all) {
+      units += kingAttackWeight[piece] *
+               (attacks.byPiece[opponent][piece] & zone).populationCount();
     }
+    units += 2 * (attacks.twice[opponent] & zone & ~attacks.byColor[color])
+                     .populationCount();
+    if (!state.forPiece(Piece::queen, opponent).isEmpty()) {
+      activity -= Score::make(std::min(units * units / 4, maxKingDanger), 0);
+    }
+    score += color == Color::white ? activity : -activity;
   }
 
+  int result = taper(score, state.phase);
+  return state.us() == Color::white ? result : -result;
+}
+
+int distance(Square::t a, Square::t b) {
+  return std::max(std::abs(Square::file(a) - Square::file(b)),
+                  std::abs(Square::rank(a) - Square::rank(b)));
+}
+
+int bitbaseScore(const GameState& state, bool strongWins) {
+  if (!strongWins) return 0;
+  Color::t strong = state.forColor(Color::white).populationCount() > 1
+                        ? Color::white
+                        : Color::black;
+  Square::t strongKing = state.forPiece(Piece::king, strong).findFirstSet();
+  Square::t weakKing =
+      state.forPiece(Piece::king, Color::opponent(strong)).findFirstSet();
+
+  int score = knownWin;
+  for (Piece::t piece : Piece::nonKing) {
+    score += Piece::worth[piece] *
+             state.forPiece(piece, strong).populationCount();
+  }
+  BitBoards::BitBoard pawns = state.forPiece(Piece::pawn, strong);
+  if (!pawns.isEmpty()) {
+    Square::t pawn = Square::reverseForColor(pawns.findFirstSet(), strong);
+    score += 20 * Square::rank(pawn);
+  } else {
+    int edge = std::max(std::abs(2 * Square::file(weakKing) - 7),
+                        std::abs(2 * Square::rank(weakKing) - 7)) /
+               2;
+    BitBoards::BitBoard bishops = state.forPiece(Piece::bishop, strong);
+    if (!bishops.isEmpty()) {
+      // Mate is only possible in the corners of the bishop’s color; a1 is
+      // dark.
+      Square::t bishop = bishops.findFirstSet();
+      bool dark = (Square::file(bishop) + Square::rank(bishop)) % 2 == 0;
+      int corner = dark ? std::min(distance(weakKing, Square::a1),
+                                   distance(weakKing, Square::h8))
+                        : std::min(distance(weakKing, Square::a8),
+                                   distance(weakKing, Square::h1));
+      edge = 7 - corner;
+    }
+    score += 30 * edge + 10 * (7 - distance(strongKing, weakKing));
+  }
+  return state.us() == strong ? score : -score;
+}
+
+EvalCache::EvalCache() : entries(size), probes{0}, hits{0} { clear(); }
+
+void EvalCache::clear() {
+  // Make sure that no key accidentally matches an empty entry.
+  for (Entry& entry : entries) {
+    entry.key = ~0ULL;
+  }
+}
+
+int EvalCache::probe(const GameState& state) {
   if (state.uneventfulHalfMoves >= 50) {
-    return 0;
+    return eval(state);
+  }
+  Entry& entry = entries[state.hash & (size - 1)];
+  probes++;
+  if (entry.key == state.hash) {
+    hits++;
+  } else {
+    entry.key = state.hash;
+    entry.score = eval(state);
   }
+  return entry.score;
+}
 
-  return result;
+EvalCache& evalCache() {
+  thread_local EvalCache cache{};
+  return cache;
 }
 
-}  // namespace Dagor::Eval
\ No newline at end of file
+}  // namespace Dagor::Eval
@@ -1,12 +1,69 @@
 #ifndef EVAL_H
 #define EVAL_H
 
+#include <cstdint>
+#include <vector>
+
 #include "game_state.h"
 
 namespace Dagor::Eval {
 
+/// @brief The score of a won bitbase endgame, before the bonus for
+/// progress: above every other evaluation, below every mate.
+constexpr int knownWin = 10000;
+
+/// @brief Evaluates a position from the point of view of the side to move:
+/// exactly for the endgames of the bitbases, with the neural network if one
+/// is loaded and by hand otherwise.
 int eval(const GameState& state);
 
+/// @brief Scores a bitbase endgame: 0 if it is drawn, otherwise `knownWin`
+/// plus the strong side’s material and its progress, i.e. how far its pawn
+/// is advanced or how close the bare king is to the edge (to the right
+/// corner with bishop and knight) and to the other king.
+int bitbaseScore(const GameState& state, bool strongWins);
+
+/// @brief The handcrafted evaluation: material, piece-square tables, pawn
+/// structure, mobility and king safety.
+int handcrafted(const GameState& state);
+
+/// @brief A direct-mapped cache of static evaluations, indexed by
+/// `GameState::hash`. Transpositions and the many leaves a search visits
+/// more than once are evaluated only once.
+class EvalCache {
+ private:
+  struct Entry {
+    std::uint64_t key;
+    std::int32_t score;
+  };
+
+  std::vector<Entry> entries;
+
+ public:
+  static constexpr std::size_t size = 1 << 16;
+
+  std::uint64_t probes;
+  std::uint64_t hits;
+
+  EvalCache();
+
+  /// @brief Returns the cached evaluation of `state`, evaluating and storing
+  /// it on a miss. Drawn positions by the 50 move rule share their hash with
+  /// the undrawn ones, so they bypass the cache.
+  int probe(const GameState& state);
+
+  /// @brief Forgets all entries, e.g. after a different network was loaded.
+  void clear();
+
+  void resetStatistics() {
+    probes = 0;
+    hits = 0;
+  }
+};
+
+/// @brief The evaluation cache of the calling thread.
+EvalCache& evalCache();
+
 }  // namespace Dagor::Eval
 
 #endif
\ No newline at end of file
@@ -1,10 +1,13 @@
 #include "game_state.h"
 
-#include <sstream>
+#include <array>
+#include <algorithm>
+#include <charconv>
 #include <stdexcept>
-#include <unordered_map>
 #include <vector>
 
+#include "tokens.h"
+
 namespace Dagor {
 
 constexpr Square::t enPassantCapture(Square::t enPassantSquare) {
@@ -75,14 +78,155 @@ BitBoards::BitBoard GameState::getAttacks(Square::t square,
   return getAttacks(square, color, occupancy());
 }
 
-bool GameState::isCheck() {
+BitBoards::BitBoard GameState::attackersTo(
+    Square::t square, BitBoards::BitBoard occupancy) const {
+  BitBoards::BitBoard bishopQueen = pieces[Piece::bishop] | pieces[Piece::queen];
+  BitBoards::BitBoard rookQueen = pieces[Piece::rook] | pieces[Piece::queen];
+  return (MoveTables::pawnAttacks(Color::black, square) &
+          forPiece(Piece::pawn, Color::white)) |
+         (MoveTables::pawnAttacks(Color::white, square) &
+          forPiece(Piece::pawn, Color::black)) |
+         (MoveTables::knightMoves(square) & pieces[Piece::knight]) |
+         (MoveTables::kingMoves(square) & pieces[Piece::king]) |
+         (MoveTables::bishopHashes[square].lookUp(occupancy) & bishopQueen) |
+         (MoveTables::rookHashes[square].lookUp(occupancy) & rookQueen);
+}
+
+/// @brief The piece values for the static exchange evaluation. The king is
+/// worth so much that no exchange ever ends with him being captured.
+constexpr std::array<int, Piece::all.size() + 1> exchangeValue = {
+    Piece::worth[Piece::pawn],  Piece::worth[Piece::knight],
+    Piece::worth[Piece::bishop], Piece::worth[Piece::rook],
+    Piece::worth[Piece::queen], 20000,
+    0};
+
+int GameState::see(Move move) const {
+  Piece::t attacker = getPiece(move.start);
+  Piece::t victim = getPiece(move.end);
+  Square::t target = move.end;
+  BitBoards::BitBoard occupancy = this->occupancy();
+  occupancy.unsetSquare(move.start);
+
+  bool enPassant = attacker == Piece::pawn && move.end == enPassantSquare;
+  if (enPassant) {
+    victim = Piece::pawn;
+    occupancy.unsetSquare(enPassantCapture(enPassantSquare));
+  }
+  int gain = exchangeValue[victim];
+  if (move.promotion != Piece::empty) {
+    attacker = move.promotion;
+    gain += exchangeValue[move.promotion] - exchangeValue[Piece::pawn];
+  }
+
+  // If the opponent neither attacks the target nor has a slider that could
+  // look through the moving piece, nothing can recapture.
+  const AttackMap &map = attacks();
+  BitBoards::BitBoard sliderAttacks = map.byPiece[them()][Piece::bishop] |
+                                      map.byPiece[them()][Piece::rook] |
+                                      map.byPiece[them()][Piece::queen];
+  if (!enPassant && !map.byColor[them()].isSet(target) &&
+      !sliderAttacks.isSet(move.start)) {
+    return gain;
+  }
+
+  std::array<int, 32> gains{};
+  int depth = 0;
+  gains[0] = gain;
+  Color::t side = them();
+  BitBoards::BitBoard bishopQueen = pieces[Piece::bishop] | pieces[Piece::queen];
+  BitBoards::BitBoard rookQueen = pieces[Piece::rook] | pieces[Piece::queen];
+  BitBoards::BitBoard attackers = attackersTo(target, occupancy) & occupancy;
+
+  while (depth + 1 < static_cast<int>(gains.size())) {
+    BitBoards::BitBoard ours = attackers & forColor(side);
+    if (ours.isEmpty()) break;
+
+    Piece::t next = Piece::king;
+    for (Piece::t piece : Piece::all) {
+      if (!(ours & pieces[piece]).isEmpty()) {
+        next = piece;
+        break;
+      }
+    }
+    depth++;
+    gains[depth] = exchangeValue[attacker] - gains[depth - 1];
+    attacker = next;
+
+    occupancy.unsetSquare((ours & pieces[next]).findFirstSet());
+    // Removing a piece may uncover a slider behind it.
+    if (next == Piece::pawn || next == Piece::bishop || next == Piece::queen) {
+      attackers |= MoveTables::bishopHashes[target].lookUp(occupancy) &
+                   bishopQueen;
+    }
+    if (next == Piece::rook || next == Piece::queen) {
+      attackers |= MoveTables::rookHashes[target].lookUp(occupancy) & rookQueen;
+    }
+    attackers &= occupancy;
+    side = Color::opponent(side);
+  }
+
+  while (depth > 0) {
+    gains[depth - 1] = -std::max(-gains[depth - 1], gains[depth]);
+    depth--;
+  }
+  return gains[0];
+}
+
+BitBoards::BitBoard GameState::checkers() const {
   Square::t kingSquare = forPiece(Piece::king, us()).findFirstSet();
-  auto attacks = getAttacks(kingSquare, us());
-  return !attacks.isEmpty();
+  return attackersTo(kingSquare, occupancy()) & forColor(them());
+}
+
+bool GameState::givesCheck(Move move, const CheckInfo &checks) const {
+  Piece::t piece = getPiece(move.start);
+  if (move.promotion == Piece::empty &&
+      checks.checkSquares[piece].isSet(move.end)) {
+    return true;
+  }
+  bool enPassant = piece == Piece::pawn && move.end == enPassantSquare;
+  bool castling = piece == Piece::king &&
+                  (move.end == move.start + 2 || move.start == move.end + 2);
+  if (!checks.discoverers.isSet(move.start) && !enPassant && !castling &&
+      move.promotion == Piece::empty) {
+    return false;
+  }
+
+  // Otherwise, look at what the sliders reach once the move is made.
+  BitBoards::BitBoard occupancy = this->occupancy();
+  occupancy.unsetSquare(move.start);
+  occupancy.setSquare(move.end);
+  BitBoards::BitBoard bishopQueen =
+      forPiece(Piece::bishop, us()) | forPiece(Piece::queen, us());
+  BitBoards::BitBoard rookQueen =
+      forPiece(Piece::rook, us()) | forPiece(Piece::queen, us());
+  bishopQueen.unsetSquare(move.start);
+  rookQueen.unsetSquare(move.start);
+  if (enPassant) {
+    occupancy.unsetSquare(enPassantCapture(enPassantSquare));
+  }
+  if (move.promotion != Piece::empty &&
+      getMoves(move.promotion, us(), move.end, occupancy)
+          .isSet(checks.theirKing)) {
+    return true;
+  }
+  if (castling) {
+    bool kingSide = move.end > move.start;
+    Square::t rookStart = kingSide ? move.start + 3 : move.start - 4;
+    Square::t rookEnd = kingSide ? move.start + 1 : move.start - 1;
+    occupancy.unsetSquare(rookStart);
+    occupancy.setSquare(rookEnd);
+    rookQueen.setSquare(rookEnd);
+  }
+  return !((MoveTables::bishopHashes[checks.theirKing].lookUp(occupancy) &
+            bishopQueen) |
+           (MoveTables::rookHashes[checks.theirKing].lookUp(occupancy) &
+            rookQueen))
+              .isEmpty();
 }
 
 struct MoveGenerator {
   std::uint8_t attacksOnKing;
+  BitBoards::BitBoard checkers;
   const Color::t myColor;
   const Color::t opponentColor;
   const Square::t kingSquare;
@@ -90,12 +234,13 @@ struct MoveGenerator {
   const GameState &state;
   BitBoards::BitBoard targets;
   BitBoards::BitBoard pins;
-  std::unordered_map<Square::t, BitBoards::BitBoard> pinRays;
+  std::array<BitBoards::BitBoard, Square::size> pinRays;
 
-  std::vector<Move> moves;
+  std::vector<Move> &moves;
 
-  MoveGenerator(const GameState &state)
+  MoveGenerator(const GameState &state, std::vector<Move> &moves)
       : attacksOnKing{0},
+        checkers{0},
         myColor{state.next},
         opponentColor{Color::opponent(state.next)},
         kingSquare{state.forPiece(Piece::king, myColor).findFirstSet()},
@@ -103,7 +248,8 @@ struct MoveGenerator {
         targets{BitBoards::all},
         pins{0},
         pinRays{},
-        moves{} {
+        moves{moves} {
+    moves.clear();
     handleLeaperAttacks(Piece::pawn);
     handleLeaperAttacks(Piece::knight);
     handleSliderAttacks();
@@ -121,6 +267,30 @@ struct MoveGenerator {
     generatePlainKingMoves();
   }
 
+  void fillCheckInfo(CheckInfo &checks) const {
+    Square::t theirKing =
+        state.forPiece(Piece::king, opponentColor).findFirstSet();
+    BitBoards::BitBoard occupancy = state.occupancy();
+    auto diagonals = MoveTables::bishopHashes[theirKing].lookUp(occupancy);
+    auto lines = MoveTables::rookHashes[theirKing].lookUp(occupancy);
+    checks.checkers = checkers;
+    checks.theirKing = theirKing;
+    checks.checkSquares[Piece::pawn] =
+        MoveTables::pawnAttacks(opponentColor, theirKing);
+    checks.checkSquares[Piece::knight] = MoveTables::knightMoves(theirKing);
+    checks.checkSquares[Piece::bishop] = diagonals;
+    checks.checkSquares[Piece::rook] = lines;
+    checks.checkSquares[Piece::queen] = diagonals | lines;
+    checks.checkSquares[Piece::king] = BitBoards::BitBoard();
+    checks.discoverers =
+        discoverers(MoveTables::bishopHashes, theirKing, diagonals,
+                    state.forPiece(Piece::bishop, myColor) |
+                        state.forPiece(Piece::queen, myColor)) |
+        discoverers(MoveTables::rookHashes, theirKing, lines,
+                    state.forPiece(Piece::rook, myColor) |
+                        state.forPiece(Piece::queen, myColor));
+  }
+
  private:
   void enPassantCaptures() {
     auto electablePawns =
@@ -141,12 +311,18 @@ struct MoveGenerator {
       Square::t attackerSquare = electablePawns.findFirstSet();
       BitBoards::BitBoard occupancy{state.occupancy()};
       occupancy.unsetSquare(capturePawn);
-      auto rays = state.getMoves(Piece::rook, myColor, kingSquare, occupancy);
-      auto ray =
-          rays & (kingSquare < attackerSquare ? BitBoards::rightOf(kingSquare)
-                                              : BitBoards::leftOf(kingSquare));
-      enterMoves(attackerSquare, Piece::pawn,
-                 BitBoards::single(state.enPassantSquare) & ray);
+      occupancy.unsetSquare(attackerSquare);
+      auto rank = BitBoards::wholeRank(Square::rank(kingSquare));
+      auto rookQueen = state.forPiece(Piece::rook, opponentColor) |
+                       state.forPiece(Piece::queen, opponentColor);
+      auto rays = MoveTables::rookHashes[kingSquare].lookUp(occupancy) & rank;
+      if ((rays & rookQueen).isEmpty()) {
+        auto ends = BitBoards::single(state.enPassantSquare);
+        if (pins.isSet(attackerSquare)) {
+          ends &= pinRays[attackerSquare];
+        }
+        enterMoves(attackerSquare, Piece::pawn, ends);
+      }
     } else {
       for (Square::t start : electablePawns) {
         if (pins.isSet(start)) {
@@ -166,35 +342,36 @@ struct MoveGenerator {
     BitBoards::BitBoard bqEmpty{0xe00000000000000};
     BitBoards::BitBoard bkEmpty{0x6000000000000000};
     BitBoards::BitBoard occupancy{state.occupancy()};
+    BitBoards::BitBoard attacked = state.attacks().byColor[opponentColor];
     if (myColor == Color::white) {
       bool right = state.castlingRights & CastlingRights::whiteQueenSide;
       right = right && (occupancy & wqEmpty).isEmpty();
-      right = right && state.getAttacks(Square::d1, myColor).isEmpty();
-      right = right && state.getAttacks(Square::c1, myColor).isEmpty();
+      right = right && !attacked.isSet(Square::d1);
+      right = right && !attacked.isSet(Square::c1);
       if (right) {
         moves.push_back(wqCastle);
       }
 
       right = state.castlingRights & CastlingRights::whiteKingSide;
       right = right && (occupancy & wkEmpty).isEmpty();
-      right = right && state.getAttacks(Square::f1, myColor).isEmpty();
-      right = right && state.getAttacks(Square::g1, myColor).isEmpty();
+      right = right && !attacked.isSet(Square::f1);
+      right = right && !attacked.isSet(Square::g1);
       if (right) {
         moves.push_back(wkCastle);
       }
     } else {
       bool right = state.castlingRights & CastlingRights::blackQueenSide;
       right = right && (occupancy & bqEmpty).isEmpty();
-      right = right && state.getAttacks(Square::d8, myColor).isEmpty();
-      right = right && state.getAttacks(Square::c8, myColor).isEmpty();
+      right = right && !attacked.isSet(Square::d8);
+      right = right && !attacked.isSet(Square::c8);
       if (right) {
         moves.push_back(bqCastle);
       }
 
       right = state.castlingRights & CastlingRights::blackKingSide;
       right = right && (occupancy & bkEmpty).isEmpty();
-      right = right && state.getAttacks(Square::f8, myColor).isEmpty();
-      right = right && state.getAttacks(Square::g8, myColor).isEmpty();
+      right = right && !attacked.isSet(Square::f8);
+      right = right && !attacked.isSet(Square::g8);
       if (right) {
         moves.push_back(bkCastle);
       }
@@ -219,12 +396,12 @@ struct MoveGenerator {
   }
 
   void generatePlainKingMoves() {
-    BitBoards::BitBoard withoutKing{state.occupancy()};
-    withoutKing.unsetSquare(kingSquare);
-    for (auto end : state.getMoves(Piece::king, myColor, kingSquare)) {
-      if (state.getAttacks(end, myColor, withoutKing).isEmpty()) {
-        moves.push_back(Move{kingSquare, end});
-      }
+    // The opponent's sliders look through our king, so squares behind him on
+    // a checking ray count as attacked.
+    BitBoards::BitBoard attacked = state.attacks().byColor[opponentColor];
+    for (auto end : state.getMoves(Piece::king, myColor, kingSquare) &
+                        ~attacked) {
+      moves.push_back(Move{kingSquare, end});
     }
   }
 
@@ -278,6 +455,7 @@ struct MoveGenerator {
     auto ourBlockers = ray & state.forColor(myColor);
     if (!attackers.isEmpty()) {
       if (ourBlockers.isEmpty()) {
+        checkers |= attackers;
         attacksOnKing += attackers.populationCount();
         targets &= ray;
       } else if (ourBlockers.populationCount() == 1 && attacksOnKing <= 1) {
@@ -288,10 +466,27 @@ struct MoveGenerator {
     }
   }
 
+  /// @return our pieces that alone block one of `sliders` from the king on
+  /// `king`, which sees `direct` along the rays of `hashes`.
+  BitBoards::BitBoard discoverers(
+      const std::array<MoveTables::BlockerHash, Square::size> &hashes,
+      Square::t king, BitBoards::BitBoard direct,
+      BitBoards::BitBoard sliders) const {
+    BitBoards::BitBoard occupancy = state.occupancy();
+    auto blockers = direct & state.forColor(myColor);
+    auto behind = hashes[king].lookUp(occupancy & ~blockers) & ~direct;
+    BitBoards::BitBoard result;
+    for (auto slider : behind & sliders) {
+      result |= hashes[slider].lookUp(occupancy) & blockers;
+    }
+    return result;
+  }
+
   void handleLeaperAttacks(Piece::t piece) {
     auto attacks = state.getMoves(piece, myColor, kingSquare) &
                    state.forPiece(piece, opponentColor);
     if (!attacks.isEmpty()) {
+      checkers |= attacks;
       attacksOnKing += attacks.populationCount();
       targets &= attacks;
     }
@@ -314,7 +509,18 @@ struct MoveGenerator {
 };
 
 std::vector<Move> GameState::generateLegalMoves() const {
-  return MoveGenerator{*this}.moves;
+  std::vector<Move> moves;
+  MoveGenerator{*this, moves};
+  return moves;
+}
+
+void GameState::generateLegalMoves(std::vector<Move> &moves) const {
+  MoveGenerator{*this, moves};
+}
+
+void GameState::generateLegalMoves(std::vector<Move> &moves,
+                                   CheckInfo &checks) const {
+  MoveGenerator{*this, moves}.fillCheckInfo(checks);
 }
 
 inline UndoInfo::UndoInfo(const GameState &state, const Move &move)
@@ -325,6 +531,7 @@ inline UndoInfo::UndoInfo(const GameState &state, const Move &move)
       enPassant{state.enPassantSquare},
       castlingRights{state.castlingRights},
       uneventfulHalfMoves{state.uneventfulHalfMoves},
+      hash{state.hash},
       flags{0} {
   if (enPassant == end && piece == Piece::pawn) {
     flags = MoveFlags::enPassant;
@@ -345,6 +552,8 @@ inline UndoInfo::UndoInfo(const GameState &state, const Move &move)
 void GameState::executeMove(Move move) {
   UndoInfo info{*(this), move};
   undoStack.push(info);
+  keyHistory.push_back(hash);
+  accumulators.push();
 
   if (info.piece != Piece::pawn && info.capture == Piece::empty) {
     uneventfulHalfMoves++;
@@ -352,6 +561,7 @@ void GameState::executeMove(Move move) {
     uneventfulHalfMoves = 0;
   }
 
+  hash ^= Zobrist::castling(castlingRights) ^ Zobrist::enPassant(enPassantSquare);
   if (info.start == Square::e1 || info.start == Square::h1 ||
       info.end == Square::h1) {
     castlingRights &= ~CastlingRights::whiteKingSide;
@@ -381,8 +591,9 @@ void GameState::executeMove(Move move) {
   } else {
     enPassantSquare = Square::noSquare;
   }
+  hash ^= Zobrist::castling(castlingRights) ^ Zobrist::enPassant(enPassantSquare);
 
-  if (info.capture != Piece::empty) {
+  if (info.flags != MoveFlags::enPassant && info.capture != Piece::empty) {
     unset(info.end);
   }
 
@@ -411,11 +622,13 @@ void GameState::executeMove(Move move) {
   }
 
   next = them();
+  hash ^= Zobrist::stateKeys.blackToMove;
 }
 
 void GameState::undoMove() {
   UndoInfo undo{undoStack.top()};
   undoStack.pop();
+  keyHistory.pop_back();
 
   enPassantSquare = undo.enPassant;
   uneventfulHalfMoves = undo.uneventfulHalfMoves;
@@ -450,9 +663,13 @@ void GameState::undoMove() {
   } else {
     set(undo.start, undo.piece, us());
   }
+
+  // The changes above went into the top frame, which is dropped as a whole.
+  accumulators.pop();
+  hash = undo.hash;
 }
 
-Move::Move(std::string const &algebraic)
+Move::Move(std::string_view algebraic)
     : start{0}, end{0}, promotion{Piece::empty}, flags{0} {
   start = Square::byName(algebraic[0], algebraic[1]);
   end = Square::byName(algebraic[2], algebraic[3]);
@@ -461,24 +678,112 @@ Move::Move(std::string const &algebraic)
   }
 }
 
-std::vector<std::string> splitFenFields(std::string const &fenString) {
-  std::istringstream iss(fenString);
-  std::vector<std::string> fields;
-  std::string field;
-  while (iss >> field) {
-    fields.push_back(field);
+/// @return how many plies back the key history can hold the position: a
+/// capture or pawn move in between rules it out.
+std::size_t reversiblePlies(const GameState &state) {
+  return std::min<std::size_t>(state.uneventfulHalfMoves,
+                               state.keyHistory.size());
+}
+
+int GameState::repetitions() const {
+  std::size_t end = reversiblePlies(*this);
+  int count = 0;
+  // The same side is to move every other ply; a repetition takes four.
+  for (std::size_t i = 4; i <= end; i += 2) {
+    count += keyHistory[keyHistory.size() - i] == hash;
+  }
+  return count;
+}
+
+bool GameState::isRepetition(int ply) const {
+  std::size_t end = reversiblePlies(*this);
+  bool earlier = false;
+  for (std::size_t i = 4; i <= end; i += 2) {
+    if (keyHistory[keyHistory.size() - i] != hash) continue;
+    if (static_cast<int>(i) < ply || earlier) return true;
+    earlier = true;
+  }
+  return false;
+}
+
+bool GameState::hasUpcomingRepetition(int ply) const {
+  if (ply < 2) return false;
+  std::size_t end =
+      std::min(reversiblePlies(*this), static_cast<std::size_t>(ply - 1));
+  BitBoards::BitBoard occupied = occupancy();
+  for (std::size_t i = 3; i <= end; i += 2) {
+    std::uint64_t moveKey = hash ^ keyHistory[keyHistory.size() - i];
+    std::size_t slot = Zobrist::cuckooTable.find(moveKey);
+    if (slot == Zobrist::CuckooTable::size) continue;
+    Square::t from = Zobrist::cuckooTable.from[slot];
+    Square::t to = Zobrist::cuckooTable.to[slot];
+    // The piece stands on one of the squares, the other one is empty.
+    if (occupied.isSet(from) == occupied.isSet(to)) continue;
+    if (getColor(occupied.isSet(from) ? from : to) != us()) continue;
+    // Sliders need the squares in between to be empty.
+    int fileStep = (Square::file(to) > Square::file(from)) -
+                   (Square::file(to) < Square::file(from));
+    int rankStep = (Square::rank(to) > Square::rank(from)) -
+                   (Square::rank(to) < Square::rank(from));
+    int step = fileStep + Coord::width * rankStep;
+    bool blocked = false;
+    if (Zobrist::reaches(Piece::queen, from, to)) {
+      for (int square = from + step; square != to && !blocked;
+           square += step) {
+        blocked = occupied.isSet(static_cast<Square::t>(square));
+      }
+    }
+    if (!blocked) return true;
   }
-  return fields;
+  return false;
+}
+
+bool GameState::hasInsufficientMaterial() const {
+  BitBoards::BitBoard minors =
+      forPiece(Piece::knight) | forPiece(Piece::bishop);
+  return (forPiece(Piece::pawn) | forPiece(Piece::rook) |
+          forPiece(Piece::queen))
+             .isEmpty() &&
+         minors.populationCount() <= 1;
+}
+
+void GameState::clear() {
+  mailbox.fill(Piece::empty);
+  pieces.fill(BitBoards::BitBoard{});
+  colors.fill(BitBoards::BitBoard{});
+  // Popping keeps the stack's memory, a new stack would allocate.
+  while (!undoStack.empty()) undoStack.pop();
+  keyHistory.clear();
+  uneventfulHalfMoves = 0;
+  castlingRights = CastlingRights::none;
+  enPassantSquare = Square::noSquare;
+  next = Color::white;
+  pieceSquareScore = Score::zero;
+  phase = 0;
+  pawnKey = 0;
+  hash = 0;
+  attackMapValid = false;
+}
+
+void GameState::setUp(Color::t next, CastlingRights::t castlingRights,
+                      Square::t enPassantSquare,
+                      std::uint8_t uneventfulHalfMoves) {
+  this->next = next;
+  this->castlingRights = castlingRights;
+  this->enPassantSquare = enPassantSquare;
+  this->uneventfulHalfMoves = uneventfulHalfMoves;
+  hash ^= Zobrist::castling(castlingRights) ^
+          Zobrist::enPassant(enPassantSquare) ^ Zobrist::blackToMove(next);
+  accumulators.reset();
 }
 
-void GameState::parseFenString(const std::string &fenString) {
-  std::vector<std::string> fields = splitFenFields(fenString);
+void GameState::parseFenString(std::string_view fenString) {
+  clear();
+  Tokenizer fields{fenString};
   int file = 0;
   int rank = Coord::width - 1;
-  for (char c : fields[0]) {
-    if (c == ' ') {
-      break;
-    } else if ('0' < c && c <= '8') {
+  for (char c : fields.next()) {
+    if ('0' < c && c <= '8') {
       file += static_cast<int>(c - '0');
     } else if (c == '/') {
       file = 0;
@@ -486,38 +791,47 @@ void GameState::parseFenString(const std::string &fenString) {
     } else {
       Color::t color = Color::pieceColorFromChar(c);
       Piece::t type = Piece::byName(c);
-      if (Piece::inRange(type)) {
-        set(Square::index(file, rank), type, color);
-        file++;
-      } else {
+      if (!Piece::inRange(type)) {
         throw std::invalid_argument{std::string("unknown character: `") + c +
                                     '`'};
+      } else if (file >= Coord::width || rank < 0) {
+        throw std::invalid_argument{"too many squares in FEN"};
       }
+      set(Square::index(file, rank), type, color);
+      file++;
     }
   }
-  next = (fields[1][0] == 'w') ? Color::white : Color::black;
-  for (char c : fields[2]) {
+  std::string_view side = fields.next();
+  Color::t toMove =
+      (side.empty() || side[0] == 'w') ? Color::white : Color::black;
+  CastlingRights::t castling = CastlingRights::none;
+  for (char c : fields.next()) {
     switch (c) {
       case 'K':
-        castlingRights |= CastlingRights::whiteKingSide;
+        castling |= CastlingRights::whiteKingSide;
         break;
       case 'Q':
-        castlingRights |= CastlingRights::whiteQueenSide;
+        castling |= CastlingRights::whiteQueenSide;
         break;
       case 'k':
-        castlingRights |= CastlingRights::blackKingSide;
+        castling |= CastlingRights::blackKingSide;
         break;
       case 'q':
-        castlingRights |= CastlingRights::blackQueenSide;
+        castling |= CastlingRights::blackQueenSide;
         break;
     }
   }
-  if (fields[3][0] == '-') {
-    enPassantSquare = Square::noSquare;
-  } else {
-    enPassantSquare = Square::byName(fields[3][0], fields[3][1]);
-  }
-  uneventfulHalfMoves = std::stoi(fields[4]);
+  std::string_view enPassant = fields.next();
+  Square::t enPassantTarget = Square::noSquare;
+  if (enPassant.size() >= 2) {
+    enPassantTarget = Square::byName(enPassant[0], enPassant[1]);
+  }
+  // EPD records have no move counters.
+  std::string_view clock = fields.next();
+  unsigned halfMoves = 0;
+  std::from_chars(clock.data(), clock.data() + clock.size(), halfMoves);
+  setUp(toMove, castling, enPassantTarget,
+        static_cast<std::uint8_t>(std::min(halfMoves, 255u)));
 }
 
 std::ostream &operator<<(std::ostream &out, const GameState &state) {
@@ -548,6 +862,9 @@ std::ostream &operator<<(std::ostream &out, const GameState &state) {
 }
 
 std::ostream &operator<<(std::ostream &out, const Move &move) {
+  if (move == nullMove) {
+    return out << "0000";
+  }
   out << Square::name(move.start) << Square::name(move.end);
   if (move.promotion != Piece::empty) {
     out << Piece::name(move.promotion, Color::black);
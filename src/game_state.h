@@ -5,11 +5,16 @@
 #include <iostream>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "attacks.h"
 #include "bitboard.h"
 #include "movetables.h"
+#include "nnue.h"
+#include "psqt.h"
 #include "types.h"
+#include "zobrist.h"
 
 namespace Dagor {
 
@@ -23,13 +28,15 @@ class Move {
   Move(Square::t start, Square::t end, Piece::t promotion = Piece::empty)
       : start{start}, end{end}, promotion{promotion}, flags{0} {}
 
-  explicit Move(std::string const &algebraic);
+  explicit Move(std::string_view algebraic);
 };
 
 const Move wkCastle{Square::e1, Square::g1};
 const Move wqCastle{Square::e1, Square::c1};
 const Move bkCastle{Square::e8, Square::g8};
 const Move bqCastle{Square::e8, Square::c8};
+/// @brief Stands for “no move”, e.g. as the best move of a mated side.
+const Move nullMove{Square::a1, Square::a1};
 
 inline bool operator==(Move const &a, Move const &b) {
   return a.start == b.start && a.end == b.end && a.promotion == b.promotion &&
@@ -46,6 +53,7 @@ struct UndoInfo {
   Square::t enPassant;
   CastlingRights::t castlingRights;
   std::uint8_t uneventfulHalfMoves;
+  std::uint64_t hash;
   /// @brief Flags marking special Moves:
   ///
   /// - `0`: a normal move
@@ -56,6 +64,21 @@ struct UndoInfo {
   UndoInfo(const GameState &state, const Move &move);
 };
 
+/// @brief What the move generator finds out about checks, so that the
+/// search need not look at attacks again.
+struct CheckInfo {
+  /// @brief The opponent’s pieces that give check to the side to move.
+  BitBoards::BitBoard checkers;
+  /// @brief The squares from which a piece of the side to move would give
+  /// check, by piece type. The king never does.
+  std::array<BitBoards::BitBoard, Piece::all.size()> checkSquares;
+  /// @brief The pieces of the side to move that stand between one of its
+  /// sliders and the opponent’s king: moving one off that line gives
+  /// discovered check.
+  BitBoards::BitBoard discoverers;
+  Square::t theirKing;
+};
+
 class GameState {
  public:
   static inline const std::string startingPosition =
@@ -69,6 +92,30 @@ class GameState {
   CastlingRights::t castlingRights;
   Square::t enPassantSquare;
   Color::t next;
+  /// @brief The sum of `Eval::pieceSquare` over all pieces on the board, kept
+  /// up to date by `set` and `unset`.
+  Score::t pieceSquareScore;
+  /// @brief The sum of `Eval::phaseWeight` over all pieces on the board.
+  int phase;
+  /// @brief A Zobrist hash of the pawns alone, used to look up cached pawn
+  /// structure evaluations.
+  std::uint64_t pawnKey;
+  /// @brief A Zobrist hash of the whole position: pieces, side to move,
+  /// castling rights and en passant square.
+  std::uint64_t hash;
+  /// @brief The hashes of the positions before each move since the position
+  /// was set up, the previous one last. Moves of the game and of the search
+  /// alike end up here, so repetitions are seen across both.
+  std::vector<std::uint64_t> keyHistory;
+  /// @brief The first layer of the neural network, one frame per move. It is
+  /// only a cache of the position, so it may be updated by const evaluation.
+  mutable NNUE::AccumulatorStack accumulators;
+
+ private:
+  mutable AttackMap attackMap;
+  mutable bool attackMapValid;
+
+ public:
 
   GameState()
       : mailbox(),
@@ -78,12 +125,20 @@ class GameState {
         uneventfulHalfMoves{0},
         castlingRights{CastlingRights::none},
         enPassantSquare{Square::noSquare},
-        next{Color::white} {
+        next{Color::white},
+        pieceSquareScore{Score::zero},
+        phase{0},
+        pawnKey{0},
+        hash{0},
+        keyHistory(),
+        accumulators(),
+        attackMap(),
+        attackMapValid{false} {
     mailbox.fill(Piece::empty);
     parseFenString(startingPosition);
   }
 
-  explicit GameState(std::string const &fen)
+  explicit GameState(std::string_view fen)
       : mailbox(),
         pieces(),
         colors(),
@@ -91,7 +146,15 @@ class GameState {
         uneventfulHalfMoves{0},
         castlingRights{CastlingRights::none},
         enPassantSquare{Square::noSquare},
-        next{Color::white} {
+        next{Color::white},
+        pieceSquareScore{Score::zero},
+        phase{0},
+        pawnKey{0},
+        hash{0},
+        keyHistory(),
+        accumulators(),
+        attackMap(),
+        attackMapValid{false} {
     mailbox.fill(Piece::empty);
     parseFenString(fen);
   }
@@ -115,6 +178,15 @@ class GameState {
 
   void unset(Square::t square) {
     Piece::t piece = getPiece(square);
+    Color::t color = getColor(square);
+    pieceSquareScore -= Eval::pieceSquare(piece, color, square);
+    phase -= Eval::phaseWeight[piece];
+    hash ^= Zobrist::piece(piece, color, square);
+    if (piece == Piece::pawn) {
+      pawnKey ^= Zobrist::piece(piece, color, square);
+    }
+    accumulators.remove(piece, color, square);
+    attackMapValid = false;
     mailbox[square] = Piece::empty;
     pieces[piece].unsetSquare(square);
     colors[Color::white].unsetSquare(square);
@@ -122,6 +194,14 @@ class GameState {
   }
 
   void set(Square::t square, Piece::t piece, Color::t color) {
+    pieceSquareScore += Eval::pieceSquare(piece, color, square);
+    phase += Eval::phaseWeight[piece];
+    hash ^= Zobrist::piece(piece, color, square);
+    if (piece == Piece::pawn) {
+      pawnKey ^= Zobrist::piece(piece, color, square);
+    }
+    accumulators.add(piece, color, square);
+    attackMapValid = false;
     mailbox[square] = piece;
     pieces[piece].setSquare(square);
     colors[color].setSquare(square);
@@ -137,20 +217,89 @@ class GameState {
   BitBoards::BitBoard getAttacks(Square::t square, Color::t color) const;
   BitBoards::BitBoard getAttacks(Square::t square, Color::t color,
                                  BitBoards::BitBoard occupancy) const;
-  bool isCheck();
+  /// @return the opponent’s pieces that give check to the side to move.
+  BitBoards::BitBoard checkers() const;
+  bool isCheck() const { return !checkers().isEmpty(); }
+
+  /// @brief The attacks of both sides in the current position, computed on
+  /// first use.
+  const AttackMap &attacks() const {
+    if (!attackMapValid) {
+      attackMap.compute(*this);
+      attackMapValid = true;
+    }
+    return attackMap;
+  }
+
+  /// @brief All pieces of both colors that attack a square.
+  /// @param square the attacked square.
+  /// @param occupancy the pieces that block sliding attacks.
+  BitBoards::BitBoard attackersTo(Square::t square,
+                                  BitBoards::BitBoard occupancy) const;
+
+  /// @brief Static exchange evaluation: the material the side to move wins
+  /// (or loses, if negative) when both sides keep recapturing on the target
+  /// square of `move` with their least valuable attacker, as long as that
+  /// pays off.
+  int see(Move move) const;
 
   std::vector<Move> generateLegalMoves() const;
+  /// @brief Replaces the contents of `moves` with the legal moves, reusing
+  /// its storage.
+  void generateLegalMoves(std::vector<Move> &moves) const;
+  /// @brief Like `generateLegalMoves(moves)`, and also tells `checks` what
+  /// the generator found out about checks.
+  void generateLegalMoves(std::vector<Move> &moves, CheckInfo &checks) const;
+
+  /// @brief Whether a legal move gives check, directly or by discovering a
+  /// slider. Only castling, en passant, promotions and moves of
+  /// `checks.discoverers` look past the precomputed squares.
+  /// @param checks as filled in by `generateLegalMoves` for this position.
+  bool givesCheck(Move move, const CheckInfo &checks) const;
+
+  /// @brief Whether a move takes a piece, en passant captures included.
+  bool isCapture(Move move) const {
+    return getPiece(move.end) != Piece::empty ||
+           (move.end == enPassantSquare && getPiece(move.start) == Piece::pawn);
+  }
+
+  /// @return how often the position occurred before, as far back as the
+  /// last capture or pawn move.
+  int repetitions() const;
+
+  /// @brief Whether the search should score the position as a draw: it
+  /// repeats one from after the root, `ply` plies ago, or it occurred twice
+  /// before (threefold repetition).
+  bool isRepetition(int ply) const;
+
+  /// @brief Whether the side to move can repeat a position from after the
+  /// root, `ply` plies ago, with a single move of a piece, so that the search can
+  /// count on a draw before playing it.
+  bool hasUpcomingRepetition(int ply) const;
+
+  /// @brief Whether neither side can ever mate: there are no pawns, rooks or
+  /// queens, and at most one knight or bishop.
+  bool hasInsufficientMaterial() const;
 
   void executeMove(Move move);
   void undoMove();
-  void parseFenString(const std::string &fenString);
+  void parseFenString(std::string_view fenString);
+
+  /// @brief Empties the board and forgets all moves, so that a new position
+  /// can be built up with `set` and `setUp`.
+  void clear();
+  /// @brief Finishes a position whose pieces have been `set`.
+  void setUp(Color::t next, CastlingRights::t castlingRights,
+             Square::t enPassantSquare, std::uint8_t uneventfulHalfMoves);
 };
 
 inline bool operator==(const GameState &a, const GameState &b) {
   return a.pieces == b.pieces && a.colors == b.colors &&
          a.uneventfulHalfMoves == b.uneventfulHalfMoves &&
          a.castlingRights == b.castlingRights &&
-         a.enPassantSquare == b.enPassantSquare && a.next == b.next;
+         a.enPassantSquare == b.enPassantSquare && a.next == b.next &&
+         a.pieceSquareScore == b.pieceSquareScore && a.phase == b.phase &&
+         a.pawnKey == b.pawnKey && a.hash == b.hash;
 }
 
 std::ostream &operator<<(std::ostream &out, const GameState &board);
@@ -1,19 +1,316 @@
 /// @file main.cpp
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
 
+#include "analyze.h"
+#include "bench.h"
+#include "bitbase.h"
+#include "datagen.h"
+#include "match.h"
+#include "nnue.h"
+#include "pgn.h"
 #include "search.h"
+#include "suite.h"
 #include "test.h"
+#include "tune.h"
 #include "uci.h"
 
 using namespace Dagor;
 
+/// @brief `analyze <epd-file> [--depth N] [--threads T] [--output file]`
+int analyze(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+              << " analyze <epd-file> [--depth N] [--threads T] "
+                 "[--output file]\n";
+    return 1;
+  }
+  Search::Limits limits{6};
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  const char *output = nullptr;
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--depth") == 0) {
+      limits.depth = std::stoi(argv[i + 1]);
+      if (limits.depth < 1) {
+        std::cerr << "--depth must be at least 1\n";
+        return 1;
+      }
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      threads = static_cast<unsigned>(std::stoi(argv[i + 1]));
+    } else if (strcmp(argv[i], "--output") == 0) {
+      output = argv[i + 1];
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+
+  std::ifstream in{argv[2]};
+  if (!in) {
+    std::cerr << "could not open " << argv[2] << '\n';
+    return 1;
+  }
+  std::ofstream file{};
+  if (output != nullptr) {
+    file.open(output);
+    if (!file) {
+      std::cerr << "could not open " << output << '\n';
+      return 1;
+    }
+  }
+  Analyze::analyze(in, output != nullptr ? file : std::cout, limits, threads);
+  return 0;
+}
+
+/// @brief `suite <epd-file> [--movetime ms]`
+int suite(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0] << " suite <epd-file> [--movetime ms]\n";
+    return 1;
+  }
+  std::chrono::milliseconds moveTime{1000};
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--movetime") == 0) {
+      moveTime = std::chrono::milliseconds{std::stol(argv[i + 1])};
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+
+  std::ifstream in{argv[2]};
+  if (!in) {
+    std::cerr << "could not open " << argv[2] << '\n';
+    return 1;
+  }
+  try {
+    Suite::run(in, std::cout, moveTime);
+  } catch (const std::invalid_argument &error) {
+    std::cerr << error.what() << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+/// @brief `match <engine> <baseline> [--openings file] [--games N]
+/// [--concurrency C] [--tc seconds+increment] [--elo0 E] [--elo1 E]`
+int match(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0]
+              << " match <engine> <baseline> [--openings file] [--games N] "
+                 "[--concurrency C] [--tc seconds+increment] [--elo0 E] "
+                 "[--elo1 E]\n";
+    return 1;
+  }
+  Match::Settings settings{{argv[2], argv[3]},
+                           {},
+                           {std::chrono::milliseconds{10000},
+                            std::chrono::milliseconds{100}},
+                           std::max(1u, std::thread::hardware_concurrency()),
+                           20000,
+                           0.0,
+                           5.0,
+                           0.05,
+                           0.05,
+                           1000,
+                           8,
+                           400};
+  auto seconds = [](const std::string &text) {
+    return std::chrono::milliseconds{std::lround(1000 * std::stod(text))};
+  };
+  for (int i = 4; i + 1 < argc; i += 2) {
+    std::string value = argv[i + 1];
+    if (strcmp(argv[i], "--openings") == 0) {
+      std::ifstream file{value};
+      if (!file) {
+        std::cerr << "could not open " << value << '\n';
+        return 1;
+      }
+      for (std::string line; std::getline(file, line);) {
+        if (line.find_first_not_of(" \t\r") != std::string::npos) {
+          settings.openings.push_back(line);
+        }
+      }
+    } else if (strcmp(argv[i], "--games") == 0) {
+      settings.maxGames = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--concurrency") == 0) {
+      settings.concurrency = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--tc") == 0) {
+      std::size_t plus = value.find('+');
+      settings.timeControl.base = seconds(value.substr(0, plus));
+      settings.timeControl.increment =
+          plus == std::string::npos ? std::chrono::milliseconds{0}
+                                    : seconds(value.substr(plus + 1));
+    } else if (strcmp(argv[i], "--elo0") == 0) {
+      settings.elo0 = std::stod(value);
+    } else if (strcmp(argv[i], "--elo1") == 0) {
+      settings.elo1 = std::stod(value);
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+  if (settings.openings.empty()) {
+    settings.openings.push_back(GameState::startingPosition);
+  }
+  Match::run(settings, std::cout);
+  return 0;
+}
+
+/// @brief `datagen <output> [--games N] [--nodes N] [--threads T]
+/// [--random-plies N] [--seed S]`
+int datagen(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+              << " datagen <output> [--games N] [--nodes N] [--threads T] "
+                 "[--random-plies N] [--seed S]\n";
+    return 1;
+  }
+  Datagen::Settings settings{argv[2],
+                             1000,
+                             5000,
+                             std::max(1u, std::thread::hardware_concurrency()),
+                             8,
+                             std::random_device{}()};
+  for (int i = 3; i + 1 < argc; i += 2) {
+    std::string value = argv[i + 1];
+    if (strcmp(argv[i], "--games") == 0) {
+      settings.games = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--nodes") == 0) {
+      settings.nodes = std::stoull(value);
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      settings.threads = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--random-plies") == 0) {
+      settings.randomPlies = std::stoi(value);
+    } else if (strcmp(argv[i], "--seed") == 0) {
+      settings.seed = std::stoull(value);
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+  Datagen::run(settings, std::cout);
+  return 0;
+}
+
+/// @brief `tune <packed-file> [--epochs N] [--threads T] [--rate R]
+/// [--result-weight W] [--output file]`
+int tune(int argc, char *argv[]) {
+  if (argc < 3) {
+    std::cerr << "usage: " << argv[0]
+              << " tune <packed-file> [--epochs N] [--threads T] [--rate R] "
+                 "[--result-weight W] [--output file]\n";
+    return 1;
+  }
+  Tune::Settings settings{argv[2],
+                          "psqt_values.h",
+                          1000,
+                          std::max(1u, std::thread::hardware_concurrency()),
+                          1.0,
+                          0.5};
+  for (int i = 3; i + 1 < argc; i += 2) {
+    std::string value = argv[i + 1];
+    if (strcmp(argv[i], "--epochs") == 0) {
+      settings.epochs = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--threads") == 0) {
+      settings.threads = static_cast<unsigned>(std::stoul(value));
+    } else if (strcmp(argv[i], "--rate") == 0) {
+      settings.learningRate = std::stod(value);
+    } else if (strcmp(argv[i], "--result-weight") == 0) {
+      settings.resultWeight = std::stod(value);
+    } else if (strcmp(argv[i], "--output") == 0) {
+      settings.output = value;
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+  if (!Tune::run(settings, std::cout)) {
+    std::cerr << "could not read " << settings.input << " or write "
+              << settings.output << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+/// @brief `pgn-to-packed <pgn-file> <output>`
+int pgnToPacked(int argc, char *argv[]) {
+  if (argc < 4) {
+    std::cerr << "usage: " << argv[0] << " pgn-to-packed <pgn-file> <output>\n";
+    return 1;
+  }
+  std::ifstream in{argv[2]};
+  if (!in) {
+    std::cerr << "could not open " << argv[2] << '\n';
+    return 1;
+  }
+  Pgn::toPacked(in, argv[3], std::cout);
+  return 0;
+}
+
+/// @brief `gen-bitbase [directory] [--threads T]`
+int genBitbase(int argc, char *argv[]) {
+  std::string directory = ".";
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  int i = 2;
+  if (argc > 2 && strncmp(argv[2], "--", 2) != 0) {
+    directory = argv[2];
+    i = 3;
+  }
+  for (; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--threads") == 0) {
+      threads = static_cast<unsigned>(std::stoul(argv[i + 1]));
+    } else {
+      std::cerr << "unknown option " << argv[i] << '\n';
+      return 1;
+    }
+  }
+  return Bitbase::run(directory, threads, std::cout) ? 0 : 1;
+}
+
 int main(int argc, char *argv[]) {
   if (argc < 2 || strcmp(argv[1], "uci") == 0) {
     UCI::universalChessInterface(std::cin, std::cout);
   } else if (strcmp(argv[1], "test") == 0) {
     Test::test();
+  } else if (strcmp(argv[1], "bench-eval") == 0) {
+    if (argc > 2 && !NNUE::load(argv[2])) {
+      std::cerr << "could not load network " << argv[2] << '\n';
+      return 1;
+    }
+    Bench::eval(std::cout);
+  } else if (strcmp(argv[1], "bench-packed") == 0) {
+    if (!Bench::packed(std::cout, argc > 2 ? argv[2] : "bench.packed")) {
+      return 1;
+    }
+  } else if (strcmp(argv[1], "bench-search") == 0) {
+    Bench::search(std::cout, argc > 2 ? std::max(1, std::atoi(argv[2])) : 5);
+  } else if (strcmp(argv[1], "bench-bitbase") == 0) {
+    Bench::bitbase(std::cout);
+  } else if (strcmp(argv[1], "analyze") == 0) {
+    return analyze(argc, argv);
+  } else if (strcmp(argv[1], "suite") == 0) {
+    return suite(argc, argv);
+  } else if (strcmp(argv[1], "match") == 0) {
+    return match(argc, argv);
+  } else if (strcmp(argv[1], "datagen") == 0) {
+    return datagen(argc, argv);
+  } else if (strcmp(argv[1], "tune") == 0) {
+    return tune(argc, argv);
+  } else if (strcmp(argv[1], "pgn-to-packed") == 0) {
+    return pgnToPacked(argc, argv);
+  } else if (strcmp(argv[1], "gen-bitbase") == 0) {
+    return genBitbase(argc, argv);
   } else if (strcmp(argv[1], "run") == 0) {
     // GameState s{"2k5/R3P1B1/3P4/3P3P/6Pn/8/2pn4/2K5 w - - 1 44"};
     //  s.executeMove(Move{"e1c1"});
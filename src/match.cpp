@@ -0,0 +1,354 @@
+#include "match.h"
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "game_state.h"
+#include "notation.h"
+#include "tokens.h"
+
+namespace Dagor::Match {
+
+using Clock = std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+/// @brief An engine running in a child process, talked to through pipes.
+class Engine {
+ private:
+  pid_t pid;
+  int input;
+  int output;
+  /// @brief Output that has been read, but not yet returned as a line.
+  std::string buffer;
+
+ public:
+  /// @brief Whether the engine answered everything in time so far. An
+  /// engine that did not is replaced before the next game.
+  bool healthy;
+
+  explicit Engine(const std::string &path)
+      : pid{-1}, input{-1}, output{-1}, buffer(), healthy{false} {
+    int toChild[2];
+    int fromChild[2];
+    if (pipe2(toChild, O_CLOEXEC) != 0) return;
+    if (pipe2(fromChild, O_CLOEXEC) != 0) {
+      close(toChild[0]);
+      close(toChild[1]);
+      return;
+    }
+    const char *file = path.c_str();
+    pid = fork();
+    if (pid == 0) {
+      // Only async-signal-safe calls until exec, other threads may hold locks.
+      dup2(toChild[0], STDIN_FILENO);
+      dup2(fromChild[1], STDOUT_FILENO);
+      int devNull = open("/dev/null", O_WRONLY);
+      if (devNull >= 0) dup2(devNull, STDERR_FILENO);
+      execl(file, file, static_cast<char *>(nullptr));
+      _exit(127);
+    } else if (pid < 0) {
+      close(toChild[1]);
+      close(fromChild[0]);
+    }
+    close(toChild[0]);
+    close(fromChild[1]);
+    if (pid > 0) {
+      input = toChild[1];
+      output = fromChild[0];
+      healthy = true;
+    }
+  }
+
+  Engine(const Engine &) = delete;
+  Engine &operator=(const Engine &) = delete;
+
+  ~Engine() {
+    if (pid <= 0) return;
+    send("quit");
+    close(input);
+    // Give the engine a moment to quit on its own.
+    for (int i = 0; i < 100 && waitpid(pid, nullptr, WNOHANG) == 0; i++) {
+      std::this_thread::sleep_for(milliseconds{10});
+    }
+    if (waitpid(pid, nullptr, WNOHANG) == 0) {
+      kill(pid, SIGKILL);
+      waitpid(pid, nullptr, 0);
+    }
+    close(output);
+  }
+
+  void send(std::string line) {
+    line += '\n';
+    const char *data = line.data();
+    std::size_t left = line.size();
+    while (left > 0) {
+      ssize_t written = write(input, data, left);
+      if (written <= 0) {
+        healthy = false;
+        return;
+      }
+      data += written;
+      left -= static_cast<std::size_t>(written);
+    }
+  }
+
+  /// @brief Reads lines until one starts with `command`.
+  /// @return `false` if the engine did not send it before `deadline`.
+  bool waitFor(std::string_view command, std::string &line,
+               Clock::time_point deadline) {
+    while (healthy) {
+      std::size_t end = buffer.find('\n');
+      if (end != std::string::npos) {
+        line = buffer.substr(0, end);
+        buffer.erase(0, end + 1);
+        if (Tokenizer{line}.next() == command) return true;
+        continue;
+      }
+
+      auto left = std::chrono::duration_cast<milliseconds>(deadline -
+                                                           Clock::now());
+      pollfd request{output, POLLIN, 0};
+      if (left.count() <= 0 ||
+          poll(&request, 1, static_cast<int>(left.count())) <= 0) {
+        break;
+      }
+      char chunk[4096];
+      ssize_t count = read(output, chunk, sizeof(chunk));
+      if (count <= 0) break;
+      buffer.append(chunk, static_cast<std::size_t>(count));
+    }
+    healthy = false;
+    return false;
+  }
+
+  /// @brief Waits until the engine has processed everything sent so far.
+  bool synchronize() {
+    std::string line;
+    send("isready");
+    return waitFor("readyok", line, Clock::now() + milliseconds{5000});
+  }
+};
+
+std::unique_ptr<Engine> start(const std::string &path) {
+  auto engine = std::make_unique<Engine>(path);
+  std::string line;
+  engine->send("uci");
+  engine->waitFor("uciok", line, Clock::now() + milliseconds{5000});
+  return engine;
+}
+
+enum class Outcome { whiteWins, blackWins, draw };
+
+struct Game {
+  Outcome outcome;
+  std::string reason;
+};
+
+int material(const GameState &state, Color::t color) {
+  int sum = 0;
+  for (Piece::t piece : Piece::nonKing) {
+    sum += Piece::worth[piece] * state.forPiece(piece, color).populationCount();
+  }
+  return sum;
+}
+
+Outcome winFor(Color::t color) {
+  return color == Color::white ? Outcome::whiteWins : Outcome::blackWins;
+}
+
+/// @param players the engines playing white and black.
+Game play(const std::array<Engine *, Color::size> &players,
+          const std::string &opening, const Settings &settings) {
+  for (Engine *engine : players) {
+    engine->send("ucinewgame");
+    if (!engine->synchronize()) {
+      return {engine == players[Color::white] ? Outcome::blackWins
+                                               : Outcome::whiteWins,
+              "engine did not start"};
+    }
+  }
+
+  GameState state{opening};
+  std::array<milliseconds, Color::size> clocks = {settings.timeControl.base,
+                                                  settings.timeControl.base};
+  milliseconds increment = settings.timeControl.increment;
+  std::string position = "position fen " + opening + " moves";
+  int leader = 0;
+  int adjudication = 0;
+
+  for (int ply = 0;; ply++) {
+    if (state.generateLegalMoves().empty()) {
+      return state.isCheck() ? Game{winFor(state.them()), "mate"}
+                             : Game{Outcome::draw, "stalemate"};
+    } else if (state.uneventfulHalfMoves >= 100) {
+      return {Outcome::draw, "50 move rule"};
+    } else if (state.repetitions() >= 2) {
+      return {Outcome::draw, "repetition"};
+    } else if (state.hasInsufficientMaterial()) {
+      return {Outcome::draw, "insufficient material"};
+    } else if (ply >= settings.maxPlies) {
+      return {Outcome::draw, "adjudication by length"};
+    }
+
+    Color::t us = state.us();
+    Engine &engine = *players[us];
+    std::ostringstream go;
+    go << "go wtime " << clocks[Color::white].count() << " btime "
+       << clocks[Color::black].count() << " winc " << increment.count()
+       << " binc " << increment.count();
+    engine.send(position);
+    engine.send(go.str());
+
+    auto start = Clock::now();
+    std::string line;
+    if (!engine.waitFor("bestmove", line, start + clocks[us])) {
+      return {winFor(state.them()), "time forfeit"};
+    }
+    clocks[us] -= std::chrono::duration_cast<milliseconds>(Clock::now() - start);
+    clocks[us] += increment;
+
+    Tokenizer tokens{line};
+    tokens.next();
+    std::string_view text = tokens.next();
+    Move move = text.size() >= 4 ? Notation::parse(state, text) : nullMove;
+    if (move == nullMove) {
+      return {winFor(state.them()), "illegal move " + std::string{text}};
+    }
+    state.executeMove(move);
+    position += ' ';
+    position += text;
+
+    int balance = material(state, Color::white) - material(state, Color::black);
+    int side = balance >= settings.adjudicationMargin    ? 1
+               : balance <= -settings.adjudicationMargin ? -1
+                                                         : 0;
+    adjudication = side != 0 && side == leader ? adjudication + 1 : 1;
+    leader = side;
+    if (leader != 0 && adjudication >= settings.adjudicationPlies) {
+      return {leader > 0 ? Outcome::whiteWins : Outcome::blackWins,
+              "adjudication by material"};
+    }
+  }
+}
+
+double expectedScore(double elo) { return 1 / (1 + std::pow(10, -elo / 400)); }
+
+double eloFromScore(double score) {
+  score = std::clamp(score, 1e-6, 1 - 1e-6);
+  return -400 * std::log10(1 / score - 1);
+}
+
+/// @return the mean score per game and its variance.
+std::pair<double, double> statistics(const Score &score) {
+  double games = score.games();
+  double wins = score.wins / games;
+  double draws = score.draws / games;
+  double mean = wins + draws / 2;
+  return {mean, wins + draws / 4 - mean * mean};
+}
+
+double logLikelihoodRatio(const Score &score, double elo0, double elo1) {
+  if (score.wins == 0 || score.losses == 0) return 0;
+  auto [mean, variance] = statistics(score);
+  double s0 = expectedScore(elo0);
+  double s1 = expectedScore(elo1);
+  return score.games() * (s1 - s0) * (2 * mean - s0 - s1) / (2 * variance);
+}
+
+std::pair<double, double> elo(const Score &score) {
+  if (score.games() == 0) return {0, 0};
+  auto [mean, variance] = statistics(score);
+  double deviation = std::sqrt(variance / score.games());
+  double low = eloFromScore(mean - 1.96 * deviation);
+  double high = eloFromScore(mean + 1.96 * deviation);
+  return {eloFromScore(mean), (high - low) / 2};
+}
+
+Score run(const Settings &settings, std::ostream &out) {
+  // A crashed engine must not take the match down with it.
+  signal(SIGPIPE, SIG_IGN);
+
+  double lower = std::log(settings.beta / (1 - settings.alpha));
+  double upper = std::log((1 - settings.beta) / settings.alpha);
+  Score score{0, 0, 0};
+  std::mutex mutex;
+  std::atomic<unsigned> nextGame{0};
+  std::atomic<bool> decided{false};
+
+  auto worker = [&]() {
+    std::array<std::unique_ptr<Engine>, 2> engines;
+    while (!decided) {
+      unsigned index = nextGame++;
+      if (index >= settings.maxGames) break;
+      for (std::size_t i = 0; i < engines.size(); i++) {
+        if (!engines[i] || !engines[i]->healthy) {
+          engines[i] = start(settings.engines[i]);
+        }
+      }
+
+      const std::string &opening =
+          settings.openings[index / 2 % settings.openings.size()];
+      bool firstIsWhite = index % 2 == 0;
+      std::array<Engine *, Color::size> players = {engines[0].get(),
+                                                   engines[1].get()};
+      if (!firstIsWhite) std::swap(players[0], players[1]);
+      Game game = play(players, opening, settings);
+
+      Outcome firstWins = firstIsWhite ? Outcome::whiteWins : Outcome::blackWins;
+      std::lock_guard<std::mutex> lock{mutex};
+      if (game.outcome == Outcome::draw) {
+        score.draws++;
+      } else if (game.outcome == firstWins) {
+        score.wins++;
+      } else {
+        score.losses++;
+      }
+      double llr = logLikelihoodRatio(score, settings.elo0, settings.elo1);
+      auto [difference, error] = elo(score);
+      out << "game " << index + 1 << ": "
+          << (game.outcome == Outcome::whiteWins   ? "1-0"
+              : game.outcome == Outcome::blackWins ? "0-1"
+                                                   : "1/2-1/2")
+          << " (" << game.reason << ", first engine "
+          << (firstIsWhite ? "white" : "black") << ")  +" << score.wins
+          << " =" << score.draws << " -" << score.losses << "  Elo "
+          << difference << " ± " << error << "  LLR " << llr << " ["
+          << lower << ", " << upper << "]\n";
+      out.flush();
+      if (llr <= lower || llr >= upper) decided = true;
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (unsigned i = 0; i < std::max(settings.concurrency, 1u); i++) {
+    workers.emplace_back(worker);
+  }
+  for (std::thread &thread : workers) {
+    thread.join();
+  }
+
+  double llr = logLikelihoodRatio(score, settings.elo0, settings.elo1);
+  if (llr >= upper) {
+    out << "H1 accepted: the first engine is " << settings.elo1
+        << " Elo stronger\n";
+  } else if (llr <= lower) {
+    out << "H0 accepted: the first engine is not " << settings.elo1
+        << " Elo stronger\n";
+  } else {
+    out << "no decision after " << score.games() << " games\n";
+  }
+  return score;
+}
+
+}  // namespace Dagor::Match
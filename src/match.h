@@ -0,0 +1,71 @@
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <array>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// @brief Plays games between two UCI engines, e.g. two builds of this one,
+/// until a sequential probability ratio test (SPRT) tells which of two Elo
+/// hypotheses holds.
+namespace Dagor::Match {
+
+struct TimeControl {
+  std::chrono::milliseconds base;
+  std::chrono::milliseconds increment;
+};
+
+struct Settings {
+  /// @brief The paths of the two engines. The first one is tested against
+  /// the second one.
+  std::array<std::string, 2> engines;
+  /// @brief The FENs the games start from. Each one is played twice, with
+  /// the engines swapping colors.
+  std::vector<std::string> openings;
+  TimeControl timeControl;
+  /// @brief How many games are played at the same time.
+  unsigned concurrency;
+  /// @brief The match ends after this many games, even if the SPRT has not
+  /// come to a conclusion.
+  unsigned maxGames;
+  /// @brief The null hypothesis (the first engine is `elo0` stronger) and
+  /// the alternative hypothesis (it is `elo1` stronger).
+  double elo0;
+  double elo1;
+  /// @brief The probabilities of accepting the wrong hypothesis.
+  double alpha;
+  double beta;
+  /// @brief A game is won once one side is ahead by this much material
+  /// for `adjudicationPlies` plies in a row.
+  int adjudicationMargin;
+  int adjudicationPlies;
+  /// @brief A game that lasts this many plies is a draw.
+  int maxPlies;
+};
+
+/// @brief The results of a match so far, from the first engine’s view.
+struct Score {
+  unsigned wins;
+  unsigned draws;
+  unsigned losses;
+
+  unsigned games() const { return wins + draws + losses; }
+};
+
+/// @brief The log-likelihood ratio of `elo1` against `elo0`, given the
+/// results so far (the trinomial approximation used by fishtest).
+double logLikelihoodRatio(const Score &score, double elo0, double elo1);
+
+/// @brief The Elo difference the results point to, and the half width of its
+/// 95% confidence interval.
+std::pair<double, double> elo(const Score &score);
+
+/// @brief Plays the match, writing one line per finished game.
+/// @return the final score.
+Score run(const Settings &settings, std::ostream &out);
+
+}  // namespace Dagor::Match
+
+#endif
@@ -0,0 +1,178 @@
+#include "nnue.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+
+#include "game_state.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace Dagor::NNUE {
+
+struct alignas(32) Network {
+  std::array<std::array<std::int16_t, hidden>, inputs> featureWeights;
+  std::array<std::int16_t, hidden> featureBias;
+  std::array<std::array<std::int16_t, hidden>, Color::size> outputWeights;
+  std::int16_t outputBias;
+};
+
+/// @brief The network in use, or `nullptr` for the handcrafted evaluation.
+/// It is only replaced between searches, so the search threads can read it
+/// without synchronization.
+static std::unique_ptr<Network> network{};
+
+bool readWeights(std::istream &in, std::int16_t *weights, std::size_t count) {
+  for (std::size_t i = 0; i < count; i++) {
+    unsigned char bytes[2];
+    if (!in.read(reinterpret_cast<char *>(bytes), 2)) return false;
+    weights[i] = static_cast<std::int16_t>(bytes[0] | (bytes[1] << 8));
+  }
+  return true;
+}
+
+bool load(std::istream &in) {
+  auto net = std::make_unique<Network>();
+  bool ok = true;
+  for (auto &row : net->featureWeights) {
+    ok = ok && readWeights(in, row.data(), hidden);
+  }
+  ok = ok && readWeights(in, net->featureBias.data(), hidden);
+  for (auto &half : net->outputWeights) {
+    ok = ok && readWeights(in, half.data(), hidden);
+  }
+  ok = ok && readWeights(in, &net->outputBias, 1);
+  if (!ok) return false;
+
+  // Anything after the weights must be padding.
+  char padding[64];
+  in.read(padding, sizeof(padding));
+  if (in.gcount() == sizeof(padding)) return false;
+
+  network = std::move(net);
+  return true;
+}
+
+bool load(const std::string &path) {
+  std::ifstream file{path, std::ios::binary};
+  return file && load(file);
+}
+
+void unload() { network.reset(); }
+
+bool isLoaded() { return network != nullptr; }
+
+/// @brief The index of the feature for a piece, as seen by `perspective`:
+/// the perspective’s own pieces come first, and black sees the board
+/// mirrored, so that both sides play “upwards”.
+constexpr std::size_t featureIndex(Color::t perspective, Change change) {
+  std::size_t side = change.color == perspective ? 0 : 1;
+  Square::t square = Square::reverseForColor(change.square, perspective);
+  return (side * Piece::all.size() + change.piece) * Square::size +
+         static_cast<std::size_t>(square);
+}
+
+/// @brief `values += weights` (or `-=`), lane by lane.
+template <bool add>
+void update(std::array<std::int16_t, hidden> &values,
+            const std::array<std::int16_t, hidden> &weights) {
+#if defined(__AVX2__)
+  for (std::size_t i = 0; i < hidden; i += 16) {
+    auto *v = reinterpret_cast<__m256i *>(&values[i]);
+    auto w = _mm256_load_si256(reinterpret_cast<const __m256i *>(&weights[i]));
+    auto x = _mm256_load_si256(v);
+    _mm256_store_si256(v, add ? _mm256_add_epi16(x, w) : _mm256_sub_epi16(x, w));
+  }
+#else
+  for (std::size_t i = 0; i < hidden; i++) {
+    values[i] = static_cast<std::int16_t>(add ? values[i] + weights[i]
+                                              : values[i] - weights[i]);
+  }
+#endif
+}
+
+/// @return the dot product of the clipped `values` with `weights`.
+std::int32_t clippedDot(const std::array<std::int16_t, hidden> &values,
+                        const std::array<std::int16_t, hidden> &weights) {
+#if defined(__AVX2__)
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i max = _mm256_set1_epi16(quantA);
+  __m256i sum = _mm256_setzero_si256();
+  for (std::size_t i = 0; i < hidden; i += 16) {
+    auto v = _mm256_load_si256(reinterpret_cast<const __m256i *>(&values[i]));
+    auto w = _mm256_load_si256(reinterpret_cast<const __m256i *>(&weights[i]));
+    v = _mm256_min_epi16(_mm256_max_epi16(v, zero), max);
+    sum = _mm256_add_epi32(sum, _mm256_madd_epi16(v, w));
+  }
+  __m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                               _mm256_extracti128_si256(sum, 1));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+  return _mm_cvtsi128_si32(half);
+#else
+  std::int32_t sum = 0;
+  for (std::size_t i = 0; i < hidden; i++) {
+    std::int32_t clipped =
+        std::clamp(static_cast<std::int32_t>(values[i]), 0, quantA);
+    sum += clipped * weights[i];
+  }
+  return sum;
+#endif
+}
+
+void refresh(Accumulator &accumulator, const GameState &state) {
+  for (Color::t perspective : Color::all) {
+    auto &values = accumulator.values[perspective];
+    values = network->featureBias;
+    for (Color::t color : Color::all) {
+      for (Piece::t piece : Piece::all) {
+        for (Square::t square : state.forPiece(piece, color)) {
+          update<true>(values, network->featureWeights[featureIndex(
+                                   perspective, {piece, color, square})]);
+        }
+      }
+    }
+  }
+}
+
+int AccumulatorStack::evaluate(const GameState &state) {
+  std::size_t first = current;
+  while (!frames[first].computed) {
+    if (frames[first].needsRefresh || first == 0) {
+      refresh(frames[current].accumulator, state);
+      frames[current].computed = true;
+      first = current;
+      break;
+    }
+    first--;
+  }
+
+  for (std::size_t i = first + 1; i <= current; i++) {
+    Frame &frame = frames[i];
+    frame.accumulator = frames[i - 1].accumulator;
+    for (Color::t perspective : Color::all) {
+      auto &values = frame.accumulator.values[perspective];
+      for (std::uint8_t j = 0; j < frame.removed; j++) {
+        update<false>(values, network->featureWeights[featureIndex(
+                                  perspective, frame.removes[j])]);
+      }
+      for (std::uint8_t j = 0; j < frame.added; j++) {
+        update<true>(values, network->featureWeights[featureIndex(
+                                 perspective, frame.adds[j])]);
+      }
+    }
+    frame.computed = true;
+  }
+
+  const Accumulator &accumulator = frames[current].accumulator;
+  std::int32_t output =
+      clippedDot(accumulator.values[state.us()],
+                 network->outputWeights[0]) +
+      clippedDot(accumulator.values[state.them()], network->outputWeights[1]);
+  std::int64_t scaled = (std::int64_t{output} + network->outputBias) * scale;
+  return static_cast<int>(scaled / (quantA * quantB));
+}
+
+}  // namespace Dagor::NNUE
@@ -0,0 +1,128 @@
+#ifndef NNUE_H
+#define NNUE_H
+
+#include <array>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace Dagor {
+class GameState;
+}
+
+/// @brief An efficiently updatable neural network (768 → hidden → 1).
+///
+/// Every piece of every color on every square is one input feature. The first
+/// layer is evaluated twice, once from white’s and once from black’s point of
+/// view, and its outputs (the accumulators) are updated incrementally as
+/// pieces come and go. The clipped accumulators of the side to move and of
+/// the opponent are concatenated and fed into a single output neuron.
+namespace Dagor::NNUE {
+
+constexpr std::size_t inputs = 2 * Piece::all.size() * Square::size;
+constexpr std::size_t hidden = 256;
+/// @brief Quantisation of the first layer and of the output layer.
+constexpr int quantA = 255;
+constexpr int quantB = 64;
+/// @brief Converts the network output to centipawns.
+constexpr int scale = 400;
+
+/// @brief Loads a network from a file. The file holds, as little endian
+/// 16 bit integers: the feature weights (`inputs × hidden`, one row of
+/// `hidden` weights per feature), the feature biases (`hidden`), the output
+/// weights (`2 × hidden`, side to move first) and the output bias (scaled by
+/// `quantA * quantB`). Trainers may pad the file to a multiple of 64 bytes.
+/// @return `true` if the network was loaded and is used from now on.
+bool load(const std::string &path);
+bool load(std::istream &in);
+/// @brief Goes back to the handcrafted evaluation.
+void unload();
+bool isLoaded();
+
+/// @brief A change of a single input feature.
+struct Change {
+  Piece::t piece;
+  Color::t color;
+  Square::t square;
+};
+
+struct alignas(32) Accumulator {
+  std::array<std::array<std::int16_t, hidden>, Color::size> values;
+};
+
+/// @brief One accumulator per ply. A move only records which features it
+/// changed; the accumulators are brought up to date lazily when a position
+/// is actually evaluated, and undoing a move just drops the top frame.
+class AccumulatorStack {
+ private:
+  static constexpr std::size_t maxChanges = 3;
+
+  struct Frame {
+    Accumulator accumulator;
+    bool computed;
+    bool needsRefresh;
+    std::uint8_t added;
+    std::uint8_t removed;
+    std::array<Change, maxChanges> adds;
+    std::array<Change, maxChanges> removes;
+  };
+
+  std::vector<Frame> frames;
+  std::size_t current;
+
+  void clear(Frame &frame) {
+    frame.computed = false;
+    frame.needsRefresh = false;
+    frame.added = 0;
+    frame.removed = 0;
+  }
+
+ public:
+  AccumulatorStack() : frames(1), current{0} { reset(); }
+
+  /// @brief Forgets everything, the next evaluation starts from scratch.
+  void reset() {
+    current = 0;
+    clear(frames[0]);
+    frames[0].needsRefresh = true;
+  }
+
+  void push() {
+    if (++current == frames.size()) frames.emplace_back();
+    clear(frames[current]);
+  }
+
+  void pop() { current--; }
+
+  void add(Piece::t piece, Color::t color, Square::t square) {
+    Frame &frame = frames[current];
+    frame.computed = false;
+    if (frame.added == maxChanges) {
+      frame.needsRefresh = true;
+    } else {
+      frame.adds[frame.added++] = {piece, color, square};
+    }
+  }
+
+  void remove(Piece::t piece, Color::t color, Square::t square) {
+    Frame &frame = frames[current];
+    frame.computed = false;
+    if (frame.removed == maxChanges) {
+      frame.needsRefresh = true;
+    } else {
+      frame.removes[frame.removed++] = {piece, color, square};
+    }
+  }
+
+  /// @brief Evaluates the position of `state`, which must be the position
+  /// that the recorded changes lead to.
+  /// @return the evaluation in centipawns from the side to move’s view.
+  int evaluate(const GameState &state);
+};
+
+}  // namespace Dagor::NNUE
+
+#endif
@@ -0,0 +1,173 @@
+#include "notation.h"
+
+#include <cstdlib>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace Dagor::Notation {
+
+bool isCastle(const GameState &state, Move move) {
+  return state.getPiece(move.start) == Piece::king &&
+         std::abs(Square::file(move.start) - Square::file(move.end)) == 2;
+}
+
+/// @return the move in SAN, but without a check mark.
+std::string plainSan(const GameState &state, Move move,
+                     const std::vector<Move> &legal) {
+  if (isCastle(state, move)) {
+    return Square::file(move.end) > Square::file(move.start) ? "O-O" : "O-O-O";
+  }
+
+  Piece::t piece = state.getPiece(move.start);
+  bool capture = state.isCapture(move);
+  std::string text;
+  if (piece == Piece::pawn) {
+    if (capture) text += Coord::fileName(Square::file(move.start));
+  } else {
+    text += Piece::name(piece, Color::white);
+    // Name the start file, rank or square if other pieces of the same kind
+    // could go to the same square.
+    bool ambiguous = false, sameFile = false, sameRank = false;
+    for (Move other : legal) {
+      if (other.end != move.end || other.start == move.start ||
+          state.getPiece(other.start) != piece) {
+        continue;
+      }
+      ambiguous = true;
+      sameFile |= Square::file(other.start) == Square::file(move.start);
+      sameRank |= Square::rank(other.start) == Square::rank(move.start);
+    }
+    if (ambiguous && (!sameFile || sameRank)) {
+      text += Coord::fileName(Square::file(move.start));
+    }
+    if (sameFile) {
+      text += Coord::rankName(Square::rank(move.start));
+    }
+  }
+  if (capture) text += 'x';
+  text += Square::name(move.end);
+  if (move.promotion != Piece::empty) {
+    text += '=';
+    text += Piece::name(move.promotion, Color::white);
+  }
+  return text;
+}
+
+std::string san(const GameState &state, Move move) {
+  std::string text = plainSan(state, move, state.generateLegalMoves());
+  GameState after{state};
+  after.executeMove(move);
+  if (after.isCheck()) {
+    text += after.generateLegalMoves().empty() ? '#' : '+';
+  }
+  return text;
+}
+
+/// @return `text` without check marks and annotations.
+std::string_view stripSuffixes(std::string_view text) {
+  while (!text.empty() && std::string_view{"+#!?"}.find(text.back()) !=
+                              std::string_view::npos) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+bool isFile(char c) { return 'a' <= c && c <= 'h'; }
+bool isRank(char c) { return '1' <= c && c <= '8'; }
+
+/// @brief Decodes SAN by its parts (piece, hints, target and promotion) and
+/// matches them against the legal moves, without writing any move in SAN.
+/// Unneeded hints, like in `Ngf3` for the only knight that can go to f3, are
+/// accepted.
+/// @return the move, or `nullMove` if no or more than one legal move fits.
+Move decodeSan(const GameState &state, std::string_view text,
+               const std::vector<Move> &legal) {
+  if (text == "O-O" || text == "O-O-O") {
+    for (Move move : legal) {
+      if (isCastle(state, move) &&
+          (Square::file(move.end) > Square::file(move.start)) ==
+              (text == "O-O")) {
+        return move;
+      }
+    }
+    return nullMove;
+  }
+
+  Piece::t piece = Piece::pawn;
+  if (!text.empty() && std::string_view{"NBRQK"}.find(text.front()) !=
+                           std::string_view::npos) {
+    piece = Piece::byName(text.front());
+    text.remove_prefix(1);
+  }
+  Piece::t promotion = Piece::empty;
+  std::size_t equals = text.find('=');
+  if (equals != std::string_view::npos && equals + 1 < text.size()) {
+    promotion = Piece::byName(text[equals + 1]);
+    text = text.substr(0, equals);
+  } else if (piece == Piece::pawn && !text.empty() &&
+             std::string_view{"NBRQ"}.find(text.back()) !=
+                 std::string_view::npos) {
+    promotion = Piece::byName(text.back());
+    text.remove_suffix(1);
+  }
+
+  // What is left is at most two hints and the target square, with captures
+  // marked by `x` and sometimes moves by `-`.
+  char parts[4];
+  std::size_t size = 0;
+  for (char c : text) {
+    if (c == 'x' || c == '-' || c == ':') continue;
+    if (size == std::size(parts) || !(isFile(c) || isRank(c))) {
+      return nullMove;
+    }
+    parts[size++] = c;
+  }
+  if (size < 2 || !isFile(parts[size - 2]) || !isRank(parts[size - 1])) {
+    return nullMove;
+  }
+  Square::t target = Square::byName(parts[size - 2], parts[size - 1]);
+
+  Move found = nullMove;
+  for (Move move : legal) {
+    if (move.end != target || move.promotion != promotion ||
+        state.getPiece(move.start) != piece) {
+      continue;
+    }
+    bool fits = true;
+    for (std::size_t i = 0; i + 2 < size; i++) {
+      fits &= isFile(parts[i]) ? Coord::fileName(Square::file(move.start)) ==
+                                     parts[i]
+                               : Coord::rankName(Square::rank(move.start)) ==
+                                     parts[i];
+    }
+    if (!fits) continue;
+    if (!(found == nullMove)) return nullMove;
+    found = move;
+  }
+  return found;
+}
+
+Move parse(const GameState &state, std::string_view text) {
+  text = stripSuffixes(text);
+  // Castling is sometimes written with zeros.
+  if (text == "0-0") text = "O-O";
+  if (text == "0-0-0") text = "O-O-O";
+
+  auto legal = state.generateLegalMoves();
+  Move decoded = decodeSan(state, text, legal);
+  if (!(decoded == nullMove)) return decoded;
+
+  for (Move move : legal) {
+    std::string uci = Square::name(move.start) + Square::name(move.end);
+    if (move.promotion != Piece::empty) {
+      uci += Piece::name(move.promotion, Color::black);
+    }
+    if (uci == text) {
+      return move;
+    }
+  }
+  return nullMove;
+}
+
+}  // namespace Dagor::Notation
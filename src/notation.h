@@ -0,0 +1,23 @@
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include <string>
+#include <string_view>
+
+#include "game_state.h"
+
+/// @brief Standard algebraic notation (SAN), as used by EPD and PGN files.
+namespace Dagor::Notation {
+
+/// @brief Writes a legal move in SAN, e.g. `Nbd2`, `exd6`, `e8=Q+` or `O-O#`.
+std::string san(const GameState &state, Move move);
+
+/// @brief Finds the legal move that `text` names. Both SAN, with or without
+/// check marks and annotations like `!?`, and UCI notation (`e2e4`) are
+/// understood.
+/// @return the move, or `nullMove` if no legal move matches.
+Move parse(const GameState &state, std::string_view text);
+
+}  // namespace Dagor::Notation
+
+#endif
@@ -0,0 +1,176 @@
+#include "packed.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <iterator>
+#include <map>
+#include <stdexcept>
+#include <utility>
+
+namespace Dagor::Packed {
+
+PackedPosition pack(const GameState &state, std::int16_t score,
+                    Result::t result, Move move) {
+  PackedPosition packed{};
+  BitBoards::BitBoard occupancy = state.occupancy();
+  if (occupancy.populationCount() > 32) {
+    throw std::invalid_argument{"too many pieces to pack"};
+  }
+  packed.occupancy = occupancy.asUint();
+  std::size_t index = 0;
+  for (Square::t square : occupancy) {
+    auto code = static_cast<std::uint8_t>(state.getColor(square) << 3 |
+                                          state.getPiece(square));
+    packed.pieces[index / 2] |= code << (index % 2 * 4);
+    index++;
+  }
+  packed.score = score;
+  if (!(move == nullMove)) {
+    packed.move = static_cast<std::uint16_t>(move.start | move.end << 6 |
+                                             move.promotion << 12);
+  }
+  packed.flags =
+      static_cast<std::uint8_t>(state.us() | state.castlingRights << 4);
+  packed.enPassant = state.enPassantSquare;
+  packed.uneventfulHalfMoves = state.uneventfulHalfMoves;
+  packed.result = result;
+  return packed;
+}
+
+void unpack(const PackedPosition &packed, GameState &state) {
+  state.clear();
+  std::size_t index = 0;
+  for (Square::t square : BitBoards::BitBoard{packed.occupancy}) {
+    std::uint8_t code = packed.pieces[index / 2] >> (index % 2 * 4) & 0xf;
+    state.set(square, code & 0b111, code >> 3);
+    index++;
+  }
+  state.setUp(packed.flags & 1, packed.flags >> 4, packed.enPassant,
+              packed.uneventfulHalfMoves);
+}
+
+Move moveOf(const PackedPosition &packed) {
+  if (packed.move == 0) return nullMove;
+  return Move{static_cast<Square::t>(packed.move & 63),
+              static_cast<Square::t>(packed.move >> 6 & 63),
+              static_cast<Piece::t>(packed.move >> 12)};
+}
+
+/// @return the mutex held while a block is appended to the file open as
+/// `descriptor`. All writers of one file in the process share it, so that
+/// their blocks never interleave, even if a block takes several writes,
+/// while writers of other files do not wait for them.
+std::shared_ptr<std::mutex> appendMutex(int descriptor) {
+  struct stat status {};
+  if (descriptor < 0 || fstat(descriptor, &status) != 0) {
+    return std::make_shared<std::mutex>();
+  }
+  static std::mutex registryMutex;
+  static std::map<std::pair<dev_t, ino_t>, std::weak_ptr<std::mutex>> files;
+  std::lock_guard<std::mutex> lock{registryMutex};
+  for (auto file = files.begin(); file != files.end();) {
+    file = file->second.expired() ? files.erase(file) : std::next(file);
+  }
+  std::weak_ptr<std::mutex> &entry = files[{status.st_dev, status.st_ino}];
+  std::shared_ptr<std::mutex> mutex = entry.lock();
+  if (!mutex) {
+    mutex = std::make_shared<std::mutex>();
+    entry = mutex;
+  }
+  return mutex;
+}
+
+Writer::Writer(const std::string &path)
+    : descriptor{::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,
+                        0644)},
+      fileMutex{appendMutex(descriptor)},
+      buffer() {
+  buffer.reserve(bufferSize);
+}
+
+Writer::~Writer() {
+  flush();
+  if (isOpen()) ::close(descriptor);
+}
+
+/// @brief Appends `size` bytes, all or nothing. If a failed write cannot be
+/// taken back, the file ends in part of a record.
+/// @return `false` if the bytes were not written, and `cut` set if the
+/// file was left cut off like that.
+bool appendWhole(int descriptor, std::mutex &mutex, const char *data,
+                 std::size_t size, bool &cut) {
+  std::lock_guard<std::mutex> lock{mutex};
+  off_t end = ::lseek(descriptor, 0, SEEK_END);
+  while (size > 0) {
+    ssize_t written = ::write(descriptor, data, size);
+    if (written < 0 && errno == EINTR) continue;
+    if (written <= 0) {
+      // Takes back the part that did get written, so that the file stays a
+      // whole number of records.
+      cut = end < 0 || ::ftruncate(descriptor, end) != 0;
+      return false;
+    }
+    data += written;
+    size -= static_cast<std::size_t>(written);
+  }
+  return true;
+}
+
+bool Writer::flush() {
+  bool cut = false;
+  bool complete =
+      buffer.empty() ||
+      (isOpen() &&
+       appendWhole(descriptor, *fileMutex,
+                   reinterpret_cast<const char *>(buffer.data()),
+                   buffer.size() * sizeof(PackedPosition), cut));
+  buffer.clear();
+  if (cut) {
+    // Records appended after a partial one would be misread, so nothing
+    // more is.
+    ::close(descriptor);
+    descriptor = -1;
+  }
+  return complete;
+}
+
+bool MappedFile::open(const std::string &path) {
+  close();
+  int descriptor = ::open(path.c_str(), O_RDONLY);
+  if (descriptor < 0) return false;
+  struct stat status {};
+  if (fstat(descriptor, &status) != 0) {
+    ::close(descriptor);
+    return false;
+  }
+  std::size_t bytes = static_cast<std::size_t>(status.st_size);
+  if (bytes >= sizeof(PackedPosition)) {
+    void *address = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (address == MAP_FAILED) {
+      ::close(descriptor);
+      return false;
+    }
+    madvise(address, bytes, MADV_SEQUENTIAL);
+    first = static_cast<const PackedPosition *>(address);
+    mappedBytes = bytes;
+    count = bytes / sizeof(PackedPosition);
+  }
+  // The mapping stays valid without the descriptor.
+  ::close(descriptor);
+  return true;
+}
+
+void MappedFile::close() {
+  if (first != nullptr) {
+    munmap(const_cast<PackedPosition *>(first), mappedBytes);
+  }
+  first = nullptr;
+  count = 0;
+  mappedBytes = 0;
+}
+
+}  // namespace Dagor::Packed
@@ -0,0 +1,118 @@
+#ifndef PACKED_H
+#define PACKED_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "game_state.h"
+
+/// @brief A fixed-size binary record of a position, for the large sets of
+/// positions that tuning and network training read.
+namespace Dagor::Packed {
+
+/// @brief The outcome of the game a position was taken from.
+namespace Result {
+using t = std::int8_t;
+enum { blackWins = -1, draw = 0, whiteWins = 1 };
+}  // namespace Result
+
+/// @brief One position in 32 bytes. Files are plain arrays of these records
+/// in the byte order of the machine (little endian on everything we run on).
+struct PackedPosition {
+  /// @brief The occupied squares.
+  std::uint64_t occupancy;
+  /// @brief A 4 bit code (`color << 3 | piece`) for each occupied square, in
+  /// the order of the squares, lower nibble first.
+  std::array<std::uint8_t, 16> pieces;
+  /// @brief The evaluation in centipawns, from white’s point of view.
+  std::int16_t score;
+  /// @brief The move that was played, `start | end << 6 | promotion << 12`
+  /// (with `Piece::empty` for no promotion), or 0 if there is none.
+  std::uint16_t move;
+  /// @brief Bit 0: black to move. Bits 4 to 7: the castling rights.
+  std::uint8_t flags;
+  /// @brief The en passant square, or `Square::noSquare`.
+  std::uint8_t enPassant;
+  std::uint8_t uneventfulHalfMoves;
+  Result::t result;
+};
+
+static_assert(sizeof(PackedPosition) == 32, "packed positions must not grow");
+
+/// @throws std::invalid_argument if the position has more than 32 pieces.
+PackedPosition pack(const GameState &state, std::int16_t score,
+                    Result::t result, Move move = nullMove);
+
+/// @brief Replaces the position of `state` with a packed one.
+void unpack(const PackedPosition &packed, GameState &state);
+
+/// @return the move stored in a record, or `nullMove`.
+Move moveOf(const PackedPosition &packed);
+
+/// @brief Appends records to a file. They are collected in a buffer and
+/// written in large blocks. A block lands whole or not at all, and the
+/// blocks of the writers of one file in a process never interleave, so
+/// several threads can each have their own writer to the same file.
+class Writer {
+ private:
+  int descriptor;
+  /// @brief Shared by the writers of the same file, held while a block is
+  /// appended.
+  std::shared_ptr<std::mutex> fileMutex;
+  std::vector<PackedPosition> buffer;
+
+ public:
+  static constexpr std::size_t bufferSize = 1 << 15;
+
+  explicit Writer(const std::string &path);
+  Writer(const Writer &) = delete;
+  Writer &operator=(const Writer &) = delete;
+  ~Writer();
+
+  bool isOpen() const { return descriptor >= 0; }
+
+  /// @return `false` if the buffer was full and could not be written.
+  bool write(const PackedPosition &position) {
+    buffer.push_back(position);
+    return buffer.size() < bufferSize || flush();
+  }
+
+  /// @brief Writes the buffered records. They are dropped either way. If a
+  /// failed block cannot be taken back off the file, the writer closes it,
+  /// and all later writes fail as well.
+  /// @return `false` if they could not be written.
+  bool flush();
+};
+
+/// @brief A read-only view of a whole file of records, mapped into memory,
+/// so iterating it copies nothing.
+class MappedFile {
+ private:
+  const PackedPosition *first;
+  std::size_t count;
+  std::size_t mappedBytes;
+
+  void close();
+
+ public:
+  MappedFile() : first{nullptr}, count{0}, mappedBytes{0} {}
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+  ~MappedFile() { close(); }
+
+  /// @return `true` if the file could be mapped. A trailing partial record
+  /// is ignored.
+  bool open(const std::string &path);
+
+  const PackedPosition *begin() const { return first; }
+  const PackedPosition *end() const { return first + count; }
+  std::size_t size() const { return count; }
+};
+
+}  // namespace Dagor::Packed
+
+#endif
@@ -0,0 +1,111 @@
+#include "pawns.h"
+
+#include "movetables.h"
+
+namespace Dagor::Eval {
+
+using BitBoards::BitBoard;
+
+constexpr Score::t doubled = Score::make(-10, -20);
+constexpr Score::t isolated = Score::make(-10, -15);
+constexpr Score::t backward = Score::make(-8, -10);
+/// @brief Bonus for a passed pawn, by its rank as seen by its owner.
+constexpr std::array<Score::t, Coord::width> passed = {
+    Score::make(0, 0),   Score::make(5, 10),  Score::make(10, 20),
+    Score::make(15, 35), Score::make(25, 60), Score::make(40, 90),
+    Score::make(60, 130), Score::make(0, 0)};
+/// @brief Middle game bonus for each pawn directly in front of the king, and
+/// for each pawn one step further ahead.
+constexpr std::int16_t shelterClose = 12;
+constexpr std::int16_t shelterFar = 6;
+
+BitBoard adjacentFiles(Coord::t file) {
+  BitBoard files{};
+  if (file > 0) files |= BitBoards::wholeFile(file - 1);
+  if (file < Coord::width - 1) files |= BitBoards::wholeFile(file + 1);
+  return files;
+}
+
+/// @return all squares on ranks strictly in front of `rank`, as seen by a
+/// pawn of the given color.
+BitBoard inFront(Color::t color, Coord::t rank) {
+  return color == Color::white ? BitBoards::above(rank)
+                               : BitBoards::below(rank);
+}
+
+/// @return all squares on `rank` and the ranks behind it, as seen by a pawn of
+/// the given color.
+BitBoard levelOrBehind(Color::t color, Coord::t rank) {
+  return ~inFront(color, rank);
+}
+
+void evaluate(PawnEntry& entry, const GameState& state) {
+  entry.score = Score::zero;
+  for (Color::t color : Color::all) {
+    BitBoard own = state.forPiece(Piece::pawn, color);
+    BitBoard their = state.forPiece(Piece::pawn, Color::opponent(color));
+    Score::t score = Score::zero;
+
+    for (Square::t square : own) {
+      Coord::t file = Square::file(square);
+      Coord::t rank = Square::rank(square);
+      BitBoard sameFile = BitBoards::wholeFile(file);
+      BitBoard neighbours = adjacentFiles(file);
+      BitBoard front = inFront(color, rank);
+
+      if ((their & (sameFile | neighbours) & front).isEmpty()) {
+        score += passed[color == Color::white ? rank : 7 - rank];
+      }
+      if ((own & neighbours).isEmpty()) {
+        score += isolated;
+      } else if ((own & neighbours & levelOrBehind(color, rank)).isEmpty()) {
+        // No pawn can ever defend this one, so it is backward if the square
+        // in front of it is controlled by the opponent.
+        Square::t stop = square + (color == Color::white ? Square::north
+                                                         : Square::south);
+        if (!(MoveTables::pawnAttacks(color, stop) & their).isEmpty()) {
+          score += backward;
+        }
+      }
+      if (!(own & sameFile & front).isEmpty()) {
+        score += doubled;
+      }
+    }
+    entry.score += color == Color::white ? score : -score;
+
+    BitBoard close = BitBoards::wholeRank(color == Color::white ? 1 : 6);
+    BitBoard far = BitBoards::wholeRank(color == Color::white ? 2 : 5);
+    for (Coord::t file : Coord::files) {
+      BitBoard shield = own & (BitBoards::wholeFile(file) | adjacentFiles(file));
+      entry.shelter[color][file] = static_cast<std::int16_t>(
+          shelterClose * (shield & close).populationCount() +
+          shelterFar * (shield & far).populationCount());
+    }
+  }
+}
+
+PawnTable::PawnTable() : entries(size), probes{0}, hits{0} {
+  // Make sure that no key accidentally matches an empty entry.
+  for (PawnEntry& entry : entries) {
+    entry.key = ~0ULL;
+  }
+}
+
+const PawnEntry& PawnTable::probe(const GameState& state) {
+  PawnEntry& entry = entries[state.pawnKey & (size - 1)];
+  probes++;
+  if (entry.key == state.pawnKey) {
+    hits++;
+  } else {
+    entry.key = state.pawnKey;
+    evaluate(entry, state);
+  }
+  return entry;
+}
+
+PawnTable& pawnTable() {
+  thread_local PawnTable table{};
+  return table;
+}
+
+}  // namespace Dagor::Eval
@@ -0,0 +1,54 @@
+#ifndef PAWNS_H
+#define PAWNS_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "game_state.h"
+#include "types.h"
+
+namespace Dagor::Eval {
+
+/// @brief The cached evaluation of one pawn structure.
+struct PawnEntry {
+  std::uint64_t key;
+  /// @brief Passed, isolated, doubled and backward pawns, as a packed score
+  /// from white’s point of view.
+  Score::t score;
+  /// @brief The middle game bonus for the pawns sheltering a king on the
+  /// first two ranks of a given file. Access: `shelter[color][file]`.
+  std::array<std::array<std::int16_t, Coord::width>, Color::size> shelter;
+};
+
+/// @brief A direct-mapped hash table of pawn structure evaluations, indexed by
+/// `GameState::pawnKey`. The pawns change only on a few moves, so nearly all
+/// probes of a search are hits.
+class PawnTable {
+ private:
+  std::vector<PawnEntry> entries;
+
+ public:
+  static constexpr std::size_t size = 1 << 13;
+
+  std::uint64_t probes;
+  std::uint64_t hits;
+
+  PawnTable();
+
+  /// @brief Finds the entry for the pawn structure of `state`, evaluating
+  /// it on a miss.
+  const PawnEntry& probe(const GameState& state);
+
+  void resetStatistics() {
+    probes = 0;
+    hits = 0;
+  }
+};
+
+/// @brief The pawn table of the calling thread.
+PawnTable& pawnTable();
+
+}  // namespace Dagor::Eval
+
+#endif
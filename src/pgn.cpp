@@ -0,0 +1,207 @@
+#include "pgn.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include "notation.h"
+#include "packed.h"
+
+namespace Dagor::Pgn {
+
+/// @brief Characters that end a move or result, and start something else.
+constexpr std::string_view delimiters = "{}()[];$\"";
+
+/// @brief How often the progress of `toPacked` is reported, in games.
+constexpr std::uint64_t reportInterval = 100000;
+
+std::string Game::tag(std::string_view name) const {
+  for (const auto &[key, value] : tags) {
+    if (key == name) return value;
+  }
+  return "";
+}
+
+Reader::Reader(std::istream &in, std::size_t chunkSize)
+    : in{in},
+      buffer(std::max<std::size_t>(chunkSize, 1)),
+      position{0},
+      filled{0},
+      atLineStart{true},
+      state{},
+      symbol() {}
+
+bool Reader::refill() {
+  in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+  filled = static_cast<std::size_t>(in.gcount());
+  position = 0;
+  return filled > 0;
+}
+
+int Reader::get() {
+  if (position == filled && !refill()) return EOF;
+  char c = buffer[position++];
+  atLineStart = c == '\n';
+  return static_cast<unsigned char>(c);
+}
+
+int Reader::peek() {
+  if (position == filled && !refill()) return EOF;
+  return static_cast<unsigned char>(buffer[position]);
+}
+
+void Reader::skipLine() {
+  for (int c = get(); c != EOF && c != '\n'; c = get()) {
+  }
+}
+
+void Reader::readTag(Game &game) {
+  std::string name;
+  int c = get();
+  for (; c != EOF && !std::isspace(c) && c != '"' && c != ']'; c = get()) {
+    name += static_cast<char>(c);
+  }
+  while (c != EOF && c != '"' && c != ']') c = get();
+  std::string value;
+  if (c == '"') {
+    for (c = get(); c != EOF && c != '"'; c = get()) {
+      if (c == '\\') c = get();
+      if (c != EOF) value += static_cast<char>(c);
+    }
+    while (c != EOF && c != ']') c = get();
+  }
+  game.tags.emplace_back(std::move(name), std::move(value));
+}
+
+void Reader::readMove(Game &game, bool &positioned) {
+  if (!game.error.empty()) return;
+  if (!positioned) {
+    std::string fen = game.tag("FEN");
+    if (!fen.empty()) game.start = fen;
+    try {
+      state.parseFenString(game.start);
+    } catch (const std::invalid_argument &error) {
+      game.error = error.what();
+      return;
+    }
+    positioned = true;
+  }
+  Move move = Notation::parse(state, symbol);
+  if (move == nullMove) {
+    game.error = symbol;
+    return;
+  }
+  game.moves.push_back(move);
+  state.executeMove(move);
+}
+
+bool Reader::next(Game &game) {
+  game.tags.clear();
+  game.start = GameState::startingPosition;
+  game.moves.clear();
+  game.result = "*";
+  game.error.clear();
+  bool started = false;
+  bool inMoves = false;
+  bool positioned = false;
+  int variations = 0;
+
+  for (;;) {
+    bool lineStart = atLineStart;
+    int c = get();
+    if (c == EOF) {
+      return started;
+    } else if (std::isspace(c)) {
+      continue;
+    } else if (c == '%' && lineStart) {
+      // An escaped line, for data of other programs.
+      skipLine();
+    } else if (c == '[') {
+      if (inMoves) {
+        // A game without a result: the tags belong to the next one.
+        position--;
+        return true;
+      }
+      readTag(game);
+      started = true;
+    } else if (c == '{') {
+      for (c = get(); c != EOF && c != '}'; c = get()) {
+      }
+    } else if (c == ';') {
+      skipLine();
+    } else if (c == '(') {
+      variations++;
+    } else if (c == ')') {
+      if (variations > 0) variations--;
+    } else if (c == '$') {
+      while (peek() != EOF && std::isdigit(peek())) get();
+    } else {
+      symbol.assign(1, static_cast<char>(c));
+      for (c = peek(); c != EOF && !std::isspace(c) &&
+                       delimiters.find(static_cast<char>(c)) ==
+                           std::string_view::npos;
+           c = peek()) {
+        symbol += static_cast<char>(get());
+      }
+      // Move numbers, `12.` and `12...`, also when written as `12.e4`.
+      if (std::isdigit(static_cast<unsigned char>(symbol.front()))) {
+        std::size_t dot = symbol.find_last_of('.');
+        if (dot != std::string::npos) symbol.erase(0, dot + 1);
+      }
+      if (symbol.empty() || variations > 0) continue;
+      started = true;
+      inMoves = true;
+      if (symbol == "1-0" || symbol == "0-1" || symbol == "1/2-1/2" ||
+          symbol == "*") {
+        game.result = symbol;
+        return true;
+      }
+      readMove(game, positioned);
+    }
+  }
+}
+
+std::uint64_t toPacked(std::istream &in, const std::string &output,
+                       std::ostream &out) {
+  Packed::Writer writer{output};
+  if (!writer.isOpen()) return 0;
+  Reader reader{in};
+  Game game{};
+  std::uint64_t games = 0;
+  std::uint64_t positions = 0;
+  bool written = true;
+  while (reader.next(game)) {
+    games++;
+    if (games % reportInterval == 0) {
+      out << games << " games, " << positions << " positions\n";
+      out.flush();
+    }
+    Packed::Result::t result;
+    if (game.result == "1-0") {
+      result = Packed::Result::whiteWins;
+    } else if (game.result == "0-1") {
+      result = Packed::Result::blackWins;
+    } else if (game.result == "1/2-1/2") {
+      result = Packed::Result::draw;
+    } else {
+      continue;
+    }
+    replay(game, [&](GameState &state, Move move) {
+      if (state.isCheck() || state.isCapture(move) ||
+          move.promotion != Piece::empty) {
+        return;
+      }
+      written = writer.write(Packed::pack(state, 0, result, move)) && written;
+      positions++;
+    });
+  }
+  written = writer.flush() && written;
+  out << games << " games, " << positions << " positions\n";
+  if (!written) {
+    out << "could not write to " << output << '\n';
+    return 0;
+  }
+  return positions;
+}
+
+}  // namespace Dagor::Pgn
@@ -0,0 +1,90 @@
+#ifndef PGN_H
+#define PGN_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "game_state.h"
+
+/// @brief Reads games in portable game notation (PGN), one at a time, from
+/// files of any size.
+namespace Dagor::Pgn {
+
+struct Game {
+  /// @brief The tag pairs, e.g. `{"White", "Carlsen, Magnus"}`, in the
+  /// order of the file.
+  std::vector<std::pair<std::string, std::string>> tags;
+  /// @brief The FEN the game starts from: the `FEN` tag, if there is one.
+  std::string start;
+  /// @brief The moves of the main line. Variations are skipped.
+  std::vector<Move> moves;
+  /// @brief `1-0`, `0-1`, `1/2-1/2` or `*`.
+  std::string result;
+  /// @brief The first move that is not legal or could not be read, or the
+  /// error in the `FEN` tag. Empty if the whole game was read. The moves
+  /// stop before it.
+  std::string error;
+
+  /// @return the value of a tag, or an empty string.
+  std::string tag(std::string_view name) const;
+};
+
+/// @brief Reads PGN in chunks of a fixed size, so a file is never in memory
+/// as a whole. The moves are decoded against the legal moves of the game so
+/// far, while they are read.
+class Reader {
+ private:
+  std::istream &in;
+  std::vector<char> buffer;
+  std::size_t position;
+  std::size_t filled;
+  bool atLineStart;
+  GameState state;
+  std::string symbol;
+
+  bool refill();
+  int get();
+  int peek();
+  void skipLine();
+  void readTag(Game &game);
+  void readMove(Game &game, bool &positioned);
+
+ public:
+  static constexpr std::size_t defaultChunkSize = 1 << 16;
+
+  explicit Reader(std::istream &in, std::size_t chunkSize = defaultChunkSize);
+
+  /// @brief Reads the next game into `game`, reusing its memory.
+  /// @return `false` if there are no more games.
+  bool next(Game &game);
+};
+
+/// @brief Calls `visit(state, move)` for each move of a game, with `state`
+/// the position before the move. `visit` may make moves on it, but has to
+/// take them back.
+template <typename Visit>
+void replay(const Game &game, Visit visit) {
+  GameState state{game.start};
+  for (Move move : game.moves) {
+    visit(state, move);
+    state.executeMove(move);
+  }
+}
+
+/// @brief Writes the quiet positions (not in check, the move played no
+/// capture or promotion) of all decided or drawn games to a file of packed
+/// positions, with the result of their game and no score, e.g. for tuning
+/// on game results alone. Progress goes to `out`.
+/// @return the number of positions written, or 0 if the file could not be
+/// written.
+std::uint64_t toPacked(std::istream &in, const std::string &output,
+                       std::ostream &out);
+
+}  // namespace Dagor::Pgn
+
+#endif
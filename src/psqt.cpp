@@ -0,0 +1,30 @@
+#include "psqt.h"
+
+#include "psqt_values.h"
+
+namespace Dagor::Eval {
+
+constexpr auto buildPieceSquareTable() {
+  std::array<std::array<std::array<Score::t, Square::size>, Piece::all.size()>,
+             Color::size>
+      table{};
+  for (Piece::t piece : Piece::all) {
+    for (Square::t square : Square::all) {
+      // The tables are written with rank 8 on top, so white has to flip.
+      std::size_t index = piece * Square::size + (square ^ 56);
+      Score::t score =
+          Score::make(middleGameWorth[piece] + middleGameTable[index],
+                      endGameWorth[piece] + endGameTable[index]);
+      table[Color::white][piece][square] = score;
+      table[Color::black][piece][square ^ 56] = -score;
+    }
+  }
+  return table;
+}
+
+const std::array<
+    std::array<std::array<Score::t, Square::size>, Piece::all.size()>,
+    Color::size>
+    pieceSquareTable = buildPieceSquareTable();
+
+}  // namespace Dagor::Eval
@@ -0,0 +1,44 @@
+#ifndef PSQT_H
+#define PSQT_H
+
+#include <array>
+
+#include "types.h"
+
+namespace Dagor::Eval {
+
+/// @brief Material plus piece-square bonus for every piece on every square,
+/// as a packed middle game/end game score from white’s point of view (black
+/// pieces have negative entries). `GameState` sums these up incrementally
+/// whenever a piece is set or removed.
+/// Access: `pieceSquareTable[color][piece][square]`.
+extern const std::array<
+    std::array<std::array<Score::t, Square::size>, Piece::all.size()>,
+    Color::size>
+    pieceSquareTable;
+
+inline Score::t pieceSquare(Piece::t piece, Color::t color, Square::t square) {
+  return pieceSquareTable[color][piece][square];
+}
+
+/// @brief How much each piece contributes to the game phase. The phase counts
+/// down from `fullPhase` in the opening to zero when only kings and pawns are
+/// left.
+constexpr std::array<int, Piece::all.size()> phaseWeight = {0, 1, 1, 2, 4, 0};
+constexpr int fullPhase = 24;
+
+/// @brief Interpolates between the middle game and the end game value of a
+/// score according to the game phase.
+/// @param score a packed score.
+/// @param phase the game phase, as tracked by `GameState`.
+/// @return the tapered value.
+constexpr int taper(Score::t score, int phase) {
+  if (phase > fullPhase) phase = fullPhase;
+  return (Score::middleGame(score) * phase +
+          Score::endGame(score) * (fullPhase - phase)) /
+         fullPhase;
+}
+
+}  // namespace Dagor::Eval
+
+#endif
@@ -0,0 +1,150 @@
+#ifndef PSQT_VALUES_H
+#define PSQT_VALUES_H
+
+#include <array>
+#include <cstdint>
+
+#include "types.h"
+
+/// @file psqt_values.h
+/// The values behind `pieceSquareTable`. `tune` writes a new version of this
+/// file, so keep it free of anything else.
+
+namespace Dagor::Eval {
+
+/// @brief The positional bonuses, as seen by white: the first row of each
+/// table is rank 8, the last one rank 1.
+using PositionTable = std::array<std::int8_t, Square::size * Piece::all.size()>;
+
+constexpr std::array<std::int16_t, Piece::all.size()> middleGameWorth =
+    Piece::worth;
+constexpr std::array<std::int16_t, Piece::all.size()> endGameWorth = {
+    120, 300, 320, 520, 920};
+
+constexpr PositionTable middleGameTable = {
+    /* Pawns */
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    50, 50, 50, 50, 50, 50, 50, 50,  //
+    10, 10, 20, 30, 30, 20, 10, 10,  //
+    5, 5, 10, 25, 25, 10, 5, 5,      //
+    0, 0, 0, 20, 20, 0, 0, 0,        //
+    5, -5, -10, 0, 0, -10, -5, 5,    //
+    5, 10, 10, -20, -20, 10, 10, 5,  //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+
+    /* Knights */
+    -50, -40, -30, -30, -30, -30, -40, -50,  //
+    -40, -20, 0, 0, 0, 0, -20, -40,          //
+    -30, 0, 10, 15, 15, 10, 0, -30,          //
+    -30, 5, 15, 20, 20, 15, 5, -30,          //
+    -30, 0, 15, 20, 20, 15, 0, -30,          //
+    -30, 5, 10, 15, 15, 10, 5, -30,          //
+    -40, -20, 0, 5, 5, 0, -20, -40,          //
+    -50, -40, -30, -30, -30, -30, -40, -50,  //
+
+    /* Bishops */
+    -20, -10, -10, -10, -10, -10, -10, -20,  //
+    -10, 0, 0, 0, 0, 0, 0, -10,              //
+    -10, 0, 5, 10, 10, 5, 0, -10,            //
+    -10, 5, 5, 10, 10, 5, 5, -10,            //
+    -10, 0, 10, 10, 10, 10, 0, -10,          //
+    -10, 10, 10, 10, 10, 10, 10, -10,        //
+    -10, 5, 0, 0, 0, 0, 5, -10,              //
+    -20, -10, -10, -10, -10, -10, -10, -20,  //
+
+    /* Rooks */
+    0, 0, 0, 0, 0, 0, 0, 0,        //
+    5, 10, 10, 10, 10, 10, 10, 5,  //
+    -5, 0, 0, 0, 0, 0, 0, -5,      //
+    -5, 0, 0, 0, 0, 0, 0, -5,      //
+    -5, 0, 0, 0, 0, 0, 0, -5,      //
+    -5, 0, 0, 0, 0, 0, 0, -5,      //
+    -5, 0, 0, 0, 0, 0, 0, -5,      //
+    0, 0, 0, 5, 5, 0, 0, 0,        //
+
+    /* Queen */
+    -20, -10, -10, -5, -5, -10, -10, -20,  //
+    -10, 0, 0, 0, 0, 0, 0, -10,            //
+    -10, 0, 5, 5, 5, 5, 0, -10,            //
+    -5, 0, 5, 5, 5, 5, 0, -5,              //
+    0, 0, 5, 5, 5, 5, 0, -5,               //
+    -10, 5, 5, 5, 5, 5, 0, -10,            //
+    -10, 0, 5, 0, 0, 0, 0, -10,            //
+    -20, -10, -10, -5, -5, -10, -10, -20,  //
+
+    /* King */
+    -30, -40, -40, -50, -50, -40, -40, -30,  //
+    -30, -40, -40, -50, -50, -40, -40, -30,  //
+    -30, -40, -40, -50, -50, -40, -40, -30,  //
+    -30, -40, -40, -50, -50, -40, -40, -30,  //
+    -20, -30, -30, -40, -40, -30, -30, -20,  //
+    -10, -20, -20, -20, -20, -20, -20, -10,  //
+    20, 20, 0, 0, 0, 0, 20, 20,              //
+    20, 30, 10, 0, 0, 10, 30, 20,            //
+};
+
+constexpr PositionTable endGameTable = {
+    /* Pawns */
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    80, 80, 80, 80, 80, 80, 80, 80,  //
+    50, 50, 50, 50, 50, 50, 50, 50,  //
+    30, 30, 30, 30, 30, 30, 30, 30,  //
+    15, 15, 15, 15, 15, 15, 15, 15,  //
+    5, 5, 5, 5, 5, 5, 5, 5,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+
+    /* Knights */
+    -40, -30, -20, -20, -20, -20, -30, -40,  //
+    -30, -10, 0, 0, 0, 0, -10, -30,          //
+    -20, 0, 10, 15, 15, 10, 0, -20,          //
+    -20, 5, 15, 20, 20, 15, 5, -20,          //
+    -20, 0, 15, 20, 20, 15, 0, -20,          //
+    -20, 5, 10, 15, 15, 10, 5, -20,          //
+    -30, -10, 0, 5, 5, 0, -10, -30,          //
+    -40, -30, -20, -20, -20, -20, -30, -40,  //
+
+    /* Bishops */
+    -15, -10, -10, -10, -10, -10, -10, -15,  //
+    -10, 0, 0, 0, 0, 0, 0, -10,              //
+    -10, 0, 5, 5, 5, 5, 0, -10,              //
+    -10, 0, 5, 10, 10, 5, 0, -10,            //
+    -10, 0, 5, 10, 10, 5, 0, -10,            //
+    -10, 0, 5, 5, 5, 5, 0, -10,              //
+    -10, 0, 0, 0, 0, 0, 0, -10,              //
+    -15, -10, -10, -10, -10, -10, -10, -15,  //
+
+    /* Rooks */
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    10, 10, 10, 10, 10, 10, 10, 10,  //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+    0, 0, 0, 0, 0, 0, 0, 0,          //
+
+    /* Queen */
+    -20, -10, -10, -5, -5, -10, -10, -20,  //
+    -10, 0, 5, 5, 5, 5, 0, -10,            //
+    -10, 5, 10, 10, 10, 10, 5, -10,        //
+    -5, 5, 10, 15, 15, 10, 5, -5,          //
+    -5, 5, 10, 15, 15, 10, 5, -5,          //
+    -10, 5, 10, 10, 10, 10, 5, -10,        //
+    -10, 0, 5, 5, 5, 5, 0, -10,            //
+    -20, -10, -10, -5, -5, -10, -10, -20,  //
+
+    /* King */
+    -50, -40, -30, -20, -20, -30, -40, -50,  //
+    -30, -20, -10, 0, 0, -10, -20, -30,      //
+    -30, -10, 20, 30, 30, 20, -10, -30,      //
+    -30, -10, 30, 40, 40, 30, -10, -30,      //
+    -30, -10, 30, 40, 40, 30, -10, -30,      //
+    -30, -10, 20, 30, 30, 20, -10, -30,      //
+    -30, -30, 0, 0, 0, 0, -30, -30,          //
+    -50, -30, -30, -30, -30, -30, -30, -50,  //
+};
+
+}  // namespace Dagor::Eval
+
+#endif
@@ -1,77 +1,433 @@
 #include "search.h"
 
 #include <algorithm>
+#include <cstdlib>
+#include <iostream>
 #include <limits>
 #include <random>
 
 #include "eval.h"
+#include "pawns.h"
+#include "tablebase.h"
 
 namespace Dagor::Search {
 
-std::vector<Move> orderedMoves(const GameState& state) {
-  auto moves = state.generateLegalMoves();
-  auto sorter = [&state](Move a, Move b) {
-    return state.getPiece(a.end) < state.getPiece(b.end);
-  };
-  std::sort(moves.begin(), moves.end(), sorter);
-  return moves;
+bool isQuiet(const GameState& state, Move move) {
+  return !state.isCapture(move) && move.promotion == Piece::empty;
 }
 
-Move random(const GameState& state) {
-  auto moves = state.generateLegalMoves();
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dis(0, moves.size() - 1);
-  std::size_t index = dis(gen);
+/// @brief Captures that win material come first, then quiet moves, then
+/// captures that lose material.
+int orderingScore(const GameState& state, Move move) {
+  if (isQuiet(state, move)) {
+    return 0;
+  }
+  int exchange = state.see(move);
+  return exchange >= 0 ? 100000 + exchange : -100000 + exchange;
+}
+
+/// @return the index of `move` in the continuation histories, following a
+/// move of `piece` to `to`.
+std::size_t continuationIndex(int piece, Square::t to, int movedPiece,
+                              Move move) {
+  return (static_cast<std::size_t>(piece) * Square::size + to) *
+             History::moves +
+         static_cast<std::size_t>(movedPiece) * Square::size + move.end;
+}
+
+/// @brief Like `orderingScore`, but quiet moves are ordered too: killers,
+/// then the counter move, then by their continuation histories.
+int orderingScore(const GameState& state, const Context& context, int ply,
+                  Move move) {
+  if (!isQuiet(state, move)) return orderingScore(state, move);
+  const Frame& frame = context.stack[ply + 2];
+  if (move == frame.killers[0]) return 90000;
+  if (move == frame.killers[1]) return 89000;
+  const Frame& previous = context.stack[ply + 1];
+  if (previous.piece >= 0 &&
+      move == context.history.counterMoves[static_cast<std::size_t>(
+                  previous.piece) * Square::size + previous.move.end]) {
+    return 88000;
+  }
+  int piece = History::piece(state.getPiece(move.start), state.us());
+  int score = 0;
+  for (int back = 0; back < 2; back++) {
+    const Frame& earlier = context.stack[ply + 1 - back];
+    if (earlier.piece < 0) continue;
+    score += context.history.continuation[back][continuationIndex(
+        earlier.piece, earlier.move.end, piece, move)];
+  }
+  return score;
+}
 
-  return moves.at(index);
+/// @brief Fills the frame of `ply` with its legal moves, best first. An
+/// insertion sort is stable and quick enough for the few dozen moves of a
+/// position, and works in place.
+void orderMoves(const GameState& state, Context& context, int ply) {
+  Frame& frame = context.stack[ply + 2];
+  state.generateLegalMoves(frame.moves, frame.checks);
+  frame.scores.clear();
+  for (std::size_t i = 0; i < frame.moves.size(); i++) {
+    Move m = frame.moves[i];
+    int score = orderingScore(state, context, ply, m);
+    frame.scores.push_back(score);
+    std::size_t j = i;
+    for (; j > 0 && frame.scores[j - 1] < score; j--) {
+      frame.moves[j] = frame.moves[j - 1];
+      frame.scores[j] = frame.scores[j - 1];
+    }
+    frame.moves[j] = m;
+    frame.scores[j] = score;
+  }
+}
+
+/// @return the frames of the calling thread, allocated on its first search.
+std::vector<Frame>& searchStack() {
+  thread_local std::vector<Frame> stack(maxDepth + 3);
+  return stack;
+}
+
+/// @brief Moves a history score towards `bonus`.
+void addBonus(std::int16_t& entry, int bonus) {
+  entry = static_cast<std::int16_t>(entry + bonus -
+                                    entry * std::abs(bonus) / History::limit);
+}
+
+/// @brief Learns from the quiet move `best` causing a beta cutoff after the
+/// quiet moves among `tried` had failed.
+void rewardQuiet(const GameState& state, Context& context, int ply, int depth,
+                 Move best, const std::vector<Move>& tried) {
+  Frame& frame = context.stack[ply + 2];
+  if (!(best == frame.killers[0])) {
+    frame.killers[1] = frame.killers[0];
+    frame.killers[0] = best;
+  }
+  const Frame& previous = context.stack[ply + 1];
+  if (previous.piece >= 0) {
+    context.history.counterMoves[static_cast<std::size_t>(previous.piece) *
+                                     Square::size +
+                                 previous.move.end] = best;
+  }
+
+  int bonus = std::min(32 * depth * depth, History::limit / 4);
+  for (Move m : tried) {
+    if (!isQuiet(state, m)) continue;
+    int piece = History::piece(state.getPiece(m.start), state.us());
+    for (int back = 0; back < 2; back++) {
+      const Frame& earlier = context.stack[ply + 1 - back];
+      if (earlier.piece < 0) continue;
+      addBonus(context.history.continuation[back][continuationIndex(
+                   earlier.piece, earlier.move.end, piece, m)],
+               m == best ? bonus : -bonus);
+    }
+    if (m == best) break;
+  }
+}
+
+Move random(const GameState& state, std::mt19937_64& generator) {
+  auto moves = state.generateLegalMoves();
+  if (moves.empty()) return nullMove;
+  std::uniform_int_distribution<std::size_t> dis(0, moves.size() - 1);
+  return moves[dis(generator)];
 }
 
 constexpr int INF = std::numeric_limits<int>::max();
+/// @brief How many nodes are searched between two looks at the clock.
+constexpr std::uint64_t clockInterval = 1024;
+
+std::chrono::milliseconds elapsed(const Context& context) {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - context.start);
+}
+
+/// @brief Starts the clock once the opponent played the expected move.
+void checkSignals(Context& context) {
+  if (context.signals->stop.load(std::memory_order_relaxed)) {
+    context.stopped = true;
+  } else if (context.pondering &&
+             !context.signals->ponder.load(std::memory_order_relaxed)) {
+    context.pondering = false;
+    context.deadline = std::chrono::steady_clock::now() + context.moveTime;
+  }
+}
+
+bool shouldStop(Context& context) {
+  if (context.nodes >= context.maxNodes) {
+    context.stopped = true;
+  } else if (context.nodes % clockInterval == 0) {
+    if (context.signals != nullptr) checkSignals(context);
+    if (context.timed && !context.pondering &&
+        std::chrono::steady_clock::now() >= context.deadline) {
+      context.stopped = true;
+    }
+  }
+  return context.stopped;
+}
+
+/// @return whether the tables cover `state`. They know nothing about
+/// castling.
+bool isInTablebase(const GameState& state, const Context& context) {
+  return state.castlingRights == CastlingRights::none &&
+         state.occupancy().populationCount() <= context.probePieces;
+}
+
+int tablebaseScore(Tablebase::Wdl::t wdl, int ply) {
+  if (wdl == Tablebase::Wdl::win) return tablebaseWin - ply;
+  if (wdl == Tablebase::Wdl::loss) return -tablebaseWin + ply;
+  // The fifty move rule makes the rest draws.
+  return 0;
+}
 
-int negatedMax(GameState& state, int depth, int alpha, int beta) {
+/// @brief Removes the moves that do not give check.
+void keepChecks(const GameState& state, std::vector<Move>& moves,
+                const CheckInfo& checks) {
+  auto quiet = std::remove_if(moves.begin(), moves.end(), [&](Move m) {
+    return !state.givesCheck(m, checks);
+  });
+  moves.erase(quiet, moves.end());
+}
+
+int negatedMax(GameState& state, Context& context, int depth, int ply,
+               int alpha, int beta) {
+  Frame& frame = context.stack[ply + 2];
+  frame.pv.clear();
+  // Nodes are counted once they are searched, so node limits are exact.
+  if (shouldStop(context)) {
+    return 0;
+  }
+  context.nodes++;
+  context.selectiveDepth = std::max(context.selectiveDepth, ply);
+  if (state.isRepetition(ply)) {
+    return 0;
+  }
+  // The side to move can repeat a position with its next move, so it gets
+  // at least a draw.
+  if (alpha < 0 && state.hasUpcomingRepetition(ply)) {
+    alpha = 0;
+    if (alpha >= beta) return beta;
+  }
+  // Right after a capture or pawn move, the outcome the tables store is the
+  // outcome of the game.
+  if (depth >= context.probeDepth && state.uneventfulHalfMoves == 0 &&
+      isInTablebase(state, context)) {
+    Tablebase::Wdl::t wdl;
+    if (Tablebase::probeWdl(state, wdl)) {
+      context.statistics.tablebaseHits++;
+      return tablebaseScore(wdl, ply);
+    }
+  }
   if (depth == 0) {
-    return Eval::eval(state);
+    context.statistics.leafNodes++;
+    if (context.mateOnly) {
+      // The attacker only gives checks, so here the defender nearly always
+      // is in check, and needs its moves generated to see whether it is mate.
+      state.generateLegalMoves(frame.moves, frame.checks);
+      return frame.moves.empty() && !frame.checks.checkers.isEmpty()
+                 ? -mate + ply
+                 : 0;
+    }
+    frame.staticEval = Eval::evalCache().probe(state);
+    return frame.staticEval;
   }
 
-  auto moves = orderedMoves(state);
+  orderMoves(state, context, ply);
+  std::vector<Move>& moves = frame.moves;
   if (moves.empty()) {
-    if (state.isCheck()) {
-      return -INF;
+    if (!frame.checks.checkers.isEmpty()) {
+      return -mate + ply;
     } else {
       return 0;
     }
   }
+  // In a mate search, the attacker moves at even plies.
+  if (context.mateOnly && ply % 2 == 0) {
+    keepChecks(state, moves, frame.checks);
+    if (moves.empty()) return alpha;
+  }
 
-  for (Move m : moves) {
+  // Extensions stop well before the end of the stack, and a mate search
+  // keeps to the plies it was asked for.
+  bool extend = !context.mateOnly && ply < 2 * context.rootDepth &&
+                ply + depth < maxDepth;
+  const std::vector<Move>& next = context.stack[ply + 3].pv;
+  for (std::size_t i = 0; i < moves.size(); i++) {
+    Move m = moves[i];
+    int extension = extend && state.givesCheck(m, frame.checks) ? 1 : 0;
+    frame.move = m;
+    frame.piece = History::piece(state.getPiece(m.start), state.us());
     state.executeMove(m);
-    int eval = -negatedMax(state, depth - 1, -beta, -alpha);
+    int eval = -negatedMax(state, context, depth - 1 + extension, ply + 1,
+                           -beta, -alpha);
     state.undoMove();
     if (eval >= beta) {
       // Move is too good, opponent will have made a different choice earlier
+      context.statistics.betaCutoffs++;
+      context.statistics.firstMoveCutoffs += i == 0;
+      if (isQuiet(state, m)) rewardQuiet(state, context, ply, depth, m, moves);
       return beta;
     }
-    alpha = std::max(alpha, eval);
+    if (eval > alpha) {
+      alpha = eval;
+      frame.pv.clear();
+      frame.pv.push_back(m);
+      frame.pv.insert(frame.pv.end(), next.begin(), next.end());
+    }
   }
   return alpha;
 }
 
-Move negatedMaxSearch(GameState& state) {
-  auto moves = state.generateLegalMoves();
-  Move bestMove = moves.front();
-  int bestScore = std::numeric_limits<int>::min();
-  for (Move m : moves) {
-    state.executeMove(m);
-    int score = -negatedMax(state, 5, -INF, +INF);
-    if (score > bestScore) {
-      bestScore = score;
-      bestMove = m;
+Result search(GameState& state, const Limits& limits) {
+  Eval::pawnTable().resetStatistics();
+  Eval::evalCache().resetStatistics();
+  auto now = std::chrono::steady_clock::now();
+  Context context{0,
+                  now,
+                  now + limits.moveTime,
+                  limits.moveTime.count() > 0,
+                  limits.nodes > 0 ? limits.nodes
+                                   : std::numeric_limits<std::uint64_t>::max(),
+                  false,
+                  limits.mate > 0
+                      ? 0
+                      : std::min(limits.probeLimit, Tablebase::largest()),
+                  limits.probeDepth,
+                  0,
+                  Statistics{0, 0, 0, 0, {}},
+                  limits.signals,
+                  limits.mate > 0,
+                  limits.signals != nullptr && limits.signals->ponder,
+                  limits.moveTime,
+                  0,
+                  searchStack(),
+                  history()};
+  for (Frame& frame : context.stack) frame.reset();
+  context.history.age();
+  // The line searched never grows the key history beyond this.
+  state.keyHistory.reserve(state.keyHistory.size() + maxDepth);
+  // The root’s moves stay in its frame, in the order of the last iteration.
+  Frame& root = context.stack[2];
+  orderMoves(state, context, 0);
+  std::vector<Move>& moves = root.moves;
+  if (moves.empty()) {
+    return {nullMove, root.checks.checkers.isEmpty() ? 0 : -mate, 0, 1,
+            elapsed(context), 0, {}, {}, {}};
+  }
+  if (!limits.searchMoves.empty()) {
+    auto outside =
+        std::stable_partition(moves.begin(), moves.end(), [&](Move m) {
+          return std::find(limits.searchMoves.begin(),
+                           limits.searchMoves.end(),
+                           m) != limits.searchMoves.end();
+        });
+    // Without a single legal one among them, all moves are searched.
+    if (outside != moves.begin()) moves.erase(outside, moves.end());
+  }
+  // Only the moves that keep the best outcome are searched, so that the
+  // search cannot throw a won endgame away.
+  Tablebase::Wdl::t wdl;
+  if (isInTablebase(state, context) &&
+      Tablebase::filterRootMoves(state, moves, wdl)) {
+    context.statistics.tablebaseHits++;
+  }
+  Result result{moves.front(), 0, 0, 0, elapsed(context), 0, {}, {}, {}};
+  // The frames end at `maxDepth`, and a line needs the one after its last.
+  int lastDepth = std::clamp(limits.depth, 1, maxDepth - 1);
+  int step = 1;
+  if (context.mateOnly) {
+    // A mate in `n` moves is `2 n - 1` plies deep, ending with the
+    // attacker’s move.
+    keepChecks(state, moves, root.checks);
+    if (moves.empty()) return result;
+    lastDepth = std::min(2 * limits.mate - 1, maxDepth - 1);
+    step = 2;
+  }
+  std::size_t count = std::min<std::size_t>(
+      static_cast<std::size_t>(std::max(limits.multiPv, 1)), moves.size());
+  for (int depth = 1; depth <= lastDepth; depth += step) {
+    context.rootDepth = depth;
+    context.selectiveDepth = 0;
+    // The best lines so far, best first. Once there are `count`, a move
+    // only needs an exact score if it beats the last of them, so all lines
+    // come out of a single pass over the moves.
+    std::vector<Line> lines;
+    for (Move m : moves) {
+      int alpha = lines.size() < count ? -INF : lines.back().score;
+      root.move = m;
+      root.piece = History::piece(state.getPiece(m.start), state.us());
+      state.executeMove(m);
+      int score = -negatedMax(state, context, depth - 1, 1, -INF, -alpha);
+      state.undoMove();
+      if (context.stopped) break;
+      if (score <= alpha) continue;
+      Line line{score, {m}};
+      line.pv.insert(line.pv.end(), context.stack[3].pv.begin(),
+                     context.stack[3].pv.end());
+      auto place = std::find_if(lines.begin(), lines.end(),
+                                [&](const Line& l) { return l.score < score; });
+      lines.insert(place, std::move(line));
+      if (lines.size() > count) lines.pop_back();
     }
-    state.undoMove();
+    if (context.stopped) break;
+
+    // The next iteration looks at the best moves first, in their order.
+    for (auto line = lines.rbegin(); line != lines.rend(); line++) {
+      auto position = std::find(moves.begin(), moves.end(), line->pv.front());
+      std::rotate(moves.begin(), position, position + 1);
+    }
+    context.statistics.iterationNodes.push_back(context.nodes - result.nodes);
+    const Line& best = lines.front();
+    result = {best.pv.front(), best.score, depth, context.nodes,
+              elapsed(context), context.selectiveDepth, best.pv,
+              context.statistics, lines};
+    if (limits.onIteration) limits.onIteration(result);
+    if (context.mateOnly && result.score > mate - maxDepth) break;
   }
-  return bestMove;
+  result.nodes = context.nodes;
+  result.time = elapsed(context);
+  return result;
+}
+
+History& history() {
+  thread_local History history{};
+  return history;
 }
 
-Move search(GameState& state) { return negatedMaxSearch(state); }
+double Statistics::effectiveBranchingFactor() const {
+  std::size_t count = iterationNodes.size();
+  if (count < 2 || iterationNodes[count - 2] == 0) return 0;
+  return static_cast<double>(iterationNodes[count - 1]) /
+         static_cast<double>(iterationNodes[count - 2]);
+}
+
+void writeStatistics(const Statistics& statistics, std::ostream& out) {
+  std::uint64_t nodes = 0;
+  for (std::uint64_t count : statistics.iterationNodes) nodes += count;
+  auto percent = [](std::uint64_t part, std::uint64_t whole) {
+    return whole == 0 ? 0.0 : 100.0 * static_cast<double>(part) /
+                                  static_cast<double>(whole);
+  };
+  out << "info string beta cutoffs " << statistics.betaCutoffs
+      << ", first move " << percent(statistics.firstMoveCutoffs,
+                                     statistics.betaCutoffs)
+      << "%\n";
+  out << "info string leaf nodes " << statistics.leafNodes << " of "
+      << nodes << " (" << percent(statistics.leafNodes, nodes) << "%)\n";
+  out << "info string tablebase hits " << statistics.tablebaseHits << "\n";
+  out << "info string effective branching factor "
+      << statistics.effectiveBranchingFactor() << "\n";
+}
+
+void printHitRate(const char* name, std::uint64_t hits, std::uint64_t probes) {
+  double rate = probes == 0 ? 0.0 : 100.0 * hits / probes;
+  std::cerr << name << ": " << hits << " hits of " << probes << " probes ("
+            << rate << "%)\n";
+}
+
+void printStatistics() {
+  const Eval::PawnTable& pawns = Eval::pawnTable();
+  printHitRate("pawn hash", pawns.hits, pawns.probes);
+  const Eval::EvalCache& evals = Eval::evalCache();
+  printHitRate("eval cache", evals.hits, evals.probes);
+}
 
 }  // namespace Dagor::Search
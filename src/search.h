@@ -1,11 +1,273 @@
 #ifndef SEARCH_H
 #define SEARCH_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <random>
+#include <vector>
+
 #include "game_state.h"
 
 namespace Dagor::Search {
 
-Move search(GameState& state);
+/// @brief The score of being mated right now; being mated in `n` plies
+/// scores `-mate + n`.
+constexpr int mate = 30000;
+
+constexpr int maxDepth = 64;
+/// @brief The score of a position the tablebases say is won, `tablebaseWin
+/// - ply` at ply `ply`: below every mate, above every evaluation.
+constexpr int tablebaseWin = mate - 2 * maxDepth;
+/// @brief The depth searched when neither depth nor time are given.
+constexpr int defaultDepth = 6;
+
+struct Result;
+
+/// @brief Flags another thread sets to steer a running search. The search
+/// looks at them every so many nodes.
+struct Signals {
+  /// @brief Ends the search as soon as possible, with the result of the last
+  /// completed iteration.
+  std::atomic<bool> stop{false};
+  /// @brief While set, the search ignores its move time: it is thinking on
+  /// the opponent’s time. Once cleared (`ponderhit`), the move time starts.
+  std::atomic<bool> ponder{false};
+};
+
+/// @brief When a search stops, and whom it tells about its progress.
+struct Limits {
+  /// @brief The depth of the last iteration, in plies. The search keeps it
+  /// within `[1, maxDepth - 1]`.
+  int depth = maxDepth;
+  /// @brief The time the search may take, or zero for no limit. An
+  /// iteration that runs out of time is thrown away.
+  std::chrono::milliseconds moveTime{0};
+  /// @brief The nodes the search may visit, or zero for no limit. Like the
+  /// move time, it cuts iterations short.
+  std::uint64_t nodes = 0;
+  /// @brief Positions with at most this many pieces are looked up in the
+  /// Syzygy tables, if any are loaded.
+  int probeLimit = 7;
+  /// @brief Inside the tree, tables are only probed with at least this much
+  /// depth left.
+  int probeDepth = 1;
+  /// @brief If positive, only looks for a mate in at most this many moves:
+  /// the side to move tries its checks, the other side all its replies. The
+  /// search ends as soon as a mate is found.
+  int mate = 0;
+  /// @brief The number of best moves to find, each with its exact score and
+  /// line.
+  int multiPv = 1;
+  /// @brief If not empty, only these moves are searched at the root.
+  std::vector<Move> searchMoves{};
+  /// @brief Called after each completed iteration.
+  std::function<void(const Result&)> onIteration{};
+  /// @brief Set by the thread that controls the search, if any.
+  const Signals* signals = nullptr;
+};
+
+/// @brief Counters of one search, to see how well the moves are ordered and
+/// how fast the tree grows.
+struct Statistics {
+  /// @brief Interior nodes in which a move failed high, and those in which
+  /// it was the first move searched.
+  std::uint64_t betaCutoffs;
+  std::uint64_t firstMoveCutoffs;
+  /// @brief Nodes at the horizon, which are evaluated statically. There is
+  /// no quiescence search, so these stand in for its nodes.
+  std::uint64_t leafNodes;
+  /// @brief Positions the tablebases were probed for successfully.
+  std::uint64_t tablebaseHits;
+  /// @brief The nodes searched by each completed iteration.
+  std::vector<std::uint64_t> iterationNodes;
+
+  /// @return the ratio of the nodes of the last two iterations, or 0 if
+  /// there were not two.
+  double effectiveBranchingFactor() const;
+};
+
+/// @brief A move at the root, with its score and the line it starts.
+struct Line {
+  int score;
+  std::vector<Move> pv;
+};
+
+/// @brief The outcome of a search.
+struct Result {
+  /// @brief The best move, or `nullMove` if there are no legal moves.
+  Move bestMove;
+  /// @brief The score of `bestMove` in centipawns for the side to move.
+  int score;
+  /// @brief The depth of the last completed iteration.
+  int depth;
+  std::uint64_t nodes;
+  /// @brief The time since the search started.
+  std::chrono::milliseconds time;
+  /// @brief The deepest ply any line of the last iteration reached.
+  int selectiveDepth;
+  /// @brief The line the search expects, starting with `bestMove`.
+  std::vector<Move> pv;
+  /// @brief The counters up to the end of the last completed iteration.
+  Statistics statistics;
+  /// @brief The `Limits::multiPv` best lines, best first; the first one is
+  /// `score` and `pv` again.
+  std::vector<Line> lines;
+};
+
+/// @brief The most legal moves any position has.
+constexpr std::size_t maxMoves = 218;
+
+/// @brief What the search keeps about one ply of the line it is searching.
+/// The frames of a thread are allocated once, with room for all moves and
+/// lines, and reused by every search, so the search itself allocates
+/// nothing.
+struct Frame {
+  /// @brief `staticEval` of a ply that was not evaluated.
+  static constexpr int noEval = -2 * mate;
+
+  /// @brief The move searched from this ply, and the piece making it as a
+  /// `History::piece` index, or -1 if there is none.
+  Move move;
+  int piece;
+  /// @brief Two quiet moves that recently caused a beta cutoff at this ply,
+  /// the most recent first.
+  std::array<Move, 2> killers;
+  /// @brief The legal moves of this ply, best first, and their ordering
+  /// scores.
+  std::vector<Move> moves;
+  std::vector<int> scores;
+  /// @brief What the move generator found out about checks at this ply.
+  CheckInfo checks;
+  int staticEval;
+  /// @brief The best line found from this ply on, built up from the next
+  /// ply’s on the way back.
+  std::vector<Move> pv;
+
+  Frame()
+      : move{nullMove},
+        piece{-1},
+        killers{nullMove, nullMove},
+        moves{},
+        scores{},
+        checks{},
+        staticEval{noEval},
+        pv{} {
+    moves.reserve(maxMoves);
+    scores.reserve(maxMoves);
+    pv.reserve(maxDepth + 1);
+  }
+
+  /// @brief Forgets what an earlier search left behind.
+  void reset() {
+    move = nullMove;
+    piece = -1;
+    killers = {nullMove, nullMove};
+    staticEval = noEval;
+    pv.clear();
+  }
+};
+
+/// @brief Scores of quiet moves learned by the searches of a thread, for
+/// ordering them. Like the frames, each thread allocates them once. They
+/// carry over from one search to the next, so that the next move starts
+/// from what the last one learned, but they are aged in between. Scores move
+/// towards a bonus or malus in proportion to how far they are from it
+/// (“gravity”), so they stay within `±limit`.
+struct History {
+  static constexpr int limit = 16384;
+  static constexpr std::size_t pieces = Piece::all.size() * Color::size;
+  static constexpr std::size_t moves = pieces * Square::size;
+
+  /// @return the index of a moving piece of a color.
+  static int piece(Piece::t piece, Color::t color) {
+    return piece * Color::size + color;
+  }
+
+  /// @brief The quiet reply that last refuted a move, by the move’s piece
+  /// and target square.
+  std::vector<Move> counterMoves;
+  /// @brief The scores of quiet moves following the move one (`[0]`) or two
+  /// (`[1]`) plies earlier, by the pieces and target squares of both.
+  std::array<std::vector<std::int16_t>, 2> continuation;
+
+  History()
+      : counterMoves(moves, nullMove),
+        continuation{std::vector<std::int16_t>(moves * moves),
+                     std::vector<std::int16_t>(moves * moves)} {}
+
+  /// @brief Forgets what earlier searches learned, keeping the memory.
+  void clear() {
+    std::fill(counterMoves.begin(), counterMoves.end(), nullMove);
+    for (std::vector<std::int16_t>& scores : continuation) {
+      std::fill(scores.begin(), scores.end(), 0);
+    }
+  }
+
+  /// @brief Halves all scores, so that what the next search learns soon
+  /// outweighs them.
+  void age() {
+    for (std::vector<std::int16_t>& scores : continuation) {
+      for (std::int16_t& score : scores) score /= 2;
+    }
+  }
+};
+
+/// @brief The state of one search, owned by the thread running it. Searches
+/// in different threads share nothing but the (read-only) network.
+struct Context {
+  std::uint64_t nodes;
+  std::chrono::steady_clock::time_point start;
+  /// @brief Only meaningful if the limits have a move time.
+  std::chrono::steady_clock::time_point deadline;
+  bool timed;
+  /// @brief The node limit, or the largest possible count.
+  std::uint64_t maxNodes;
+  bool stopped;
+  /// @brief The most pieces of a position that is probed, or 0.
+  int probePieces;
+  int probeDepth;
+  int selectiveDepth;
+  Statistics statistics;
+  const Signals* signals;
+  /// @brief Set for `Limits::mate`: the side to move at the root may only
+  /// give check, and only mates count.
+  bool mateOnly;
+  /// @brief The deadline is only set once pondering ends.
+  bool pondering;
+  std::chrono::milliseconds moveTime;
+  /// @brief The depth of the current iteration. Lines are extended to at
+  /// most twice as many plies.
+  int rootDepth;
+  /// @brief The thread’s frames: one per ply, after two empty ones, so
+  /// that the frames of the last two moves always exist. The frame of ply
+  /// `ply` is `stack[ply + 2]`.
+  std::vector<Frame>& stack;
+  History& history;
+};
+
+/// @brief Searches `state` by iterative deepening. `state` is the same
+/// position again afterwards.
+Result search(GameState& state, const Limits& limits);
+
+/// @return the history the searches of the calling thread share. Clearing
+/// it makes the next search independent of earlier ones, as for a new game.
+History& history();
+
+/// @return a uniformly random legal move, or `nullMove` if there is none.
+Move random(const GameState& state, std::mt19937_64& generator);
+
+/// @brief Writes the counters of `statistics` as UCI `info string` lines.
+void writeStatistics(const Statistics& statistics, std::ostream& out);
+
+/// @brief Writes the hit rates of the calling thread’s caches during its
+/// last search to `std::cerr`.
+void printStatistics();
 
 }  // namespace Dagor::Search
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,120 @@
+#include "suite.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include "notation.h"
+#include "search.h"
+#include "tokens.h"
+
+namespace Dagor::Suite {
+
+bool Problem::isSolvedBy(Move move) const {
+  bool isBest = best.empty() ||
+                std::find(best.begin(), best.end(), move) != best.end();
+  bool isAvoided = std::find(avoid.begin(), avoid.end(), move) != avoid.end();
+  return isBest && !isAvoided;
+}
+
+Problem parse(std::string_view line) {
+  Tokenizer tokens{line};
+  std::string_view first = tokens.next();
+  std::string_view last = first;
+  for (int field = 1; field < 4; field++) {
+    last = tokens.next();
+  }
+  Problem problem{std::string{span(first, last)}, "", {}, {}};
+  GameState state{problem.position};
+
+  std::string_view operations = tokens.remainder();
+  while (!operations.empty()) {
+    std::size_t end = operations.find(';');
+    Tokenizer operation{operations.substr(0, end)};
+    operations.remove_prefix(end == std::string_view::npos ? operations.size()
+                                                           : end + 1);
+
+    std::string_view opcode = operation.next();
+    if (opcode == "bm" || opcode == "am") {
+      auto &moves = opcode == "bm" ? problem.best : problem.avoid;
+      while (!operation.done()) {
+        std::string_view text = operation.next();
+        Move move = Notation::parse(state, text);
+        if (move == nullMove) {
+          throw std::invalid_argument{"illegal move " + std::string{text} +
+                                      " in " + problem.position};
+        }
+        moves.push_back(move);
+      }
+    } else if (opcode == "id") {
+      std::string_view id = operation.remainder();
+      if (id.size() >= 2 && id.front() == '"' && id.back() == '"') {
+        id = id.substr(1, id.size() - 2);
+      }
+      problem.id = id;
+    }
+  }
+  return problem;
+}
+
+/// @return the smallest value that `percent` percent of `values` do not
+/// exceed. `values` must be sorted and non-empty.
+template <typename T>
+T percentile(const std::vector<T> &values, int percent) {
+  std::size_t rank = static_cast<std::size_t>(
+      std::ceil(values.size() * percent / 100.0));
+  return values[std::max<std::size_t>(rank, 1) - 1];
+}
+
+void run(std::istream &in, std::ostream &out,
+         std::chrono::milliseconds moveTime) {
+  std::size_t count = 0;
+  std::vector<long> times;
+  std::vector<std::uint64_t> nodes;
+
+  std::string line;
+  while (std::getline(in, line)) {
+    if (Tokenizer{line}.done()) continue;
+    count++;
+    Problem problem = parse(line);
+    GameState state{problem.position};
+
+    bool solved = false;
+    Search::Result solution{nullMove, 0, 0, 0, {}, 0, {}, {}, {}};
+    Search::Limits limits{};
+    limits.moveTime = moveTime;
+    limits.onIteration = [&](const Search::Result &result) {
+      if (!problem.isSolvedBy(result.bestMove)) {
+        solved = false;
+      } else if (!solved) {
+        solved = true;
+        solution = result;
+      }
+    };
+    Search::Result result = Search::search(state, limits);
+
+    out << (problem.id.empty() ? problem.position : problem.id) << ": ";
+    if (solved) {
+      out << "solved at depth " << solution.depth << " after "
+          << solution.time.count() << " ms, " << solution.nodes << " nodes\n";
+      times.push_back(solution.time.count());
+      nodes.push_back(solution.nodes);
+    } else if (result.bestMove == nullMove) {
+      out << "not solved, there are no legal moves\n";
+    } else {
+      out << "not solved, played " << Notation::san(state, result.bestMove)
+          << " at depth " << result.depth << '\n';
+    }
+  }
+
+  out << "solved " << times.size() << " of " << count << '\n';
+  if (times.empty()) return;
+  std::sort(times.begin(), times.end());
+  std::sort(nodes.begin(), nodes.end());
+  for (int percent : {50, 75, 90, 100}) {
+    out << percent << "% of the solutions within " << percentile(times, percent)
+        << " ms, " << percentile(nodes, percent) << " nodes\n";
+  }
+}
+
+}  // namespace Dagor::Suite
@@ -0,0 +1,44 @@
+#ifndef SUITE_H
+#define SUITE_H
+
+#include <chrono>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "game_state.h"
+
+namespace Dagor::Suite {
+
+/// @brief One position of a test suite.
+struct Problem {
+  /// @brief The position as given in the file.
+  std::string position;
+  /// @brief The `id` operation, if there is one.
+  std::string id;
+  /// @brief The moves of the `bm` operation: one of them has to be played.
+  std::vector<Move> best;
+  /// @brief The moves of the `am` operation: none of them may be played.
+  std::vector<Move> avoid;
+
+  bool isSolvedBy(Move move) const;
+};
+
+/// @brief Reads an EPD record, e.g.
+/// `6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#; id "mate";`.
+/// @throws std::invalid_argument if the position or a move is malformed.
+Problem parse(std::string_view line);
+
+/// @brief Searches every problem of an EPD stream for `moveTime` and reports
+/// which ones were solved, and when: the time and nodes at the end of the
+/// iteration after which the search kept to a right move. Finally, the
+/// number of solved problems and percentiles of the time and nodes to the
+/// solution are written.
+void run(std::istream &in, std::ostream &out,
+         std::chrono::milliseconds moveTime);
+
+}  // namespace Dagor::Suite
+
+#endif
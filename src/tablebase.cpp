@@ -0,0 +1,149 @@
+#include "tablebase.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+
+#ifdef DAGOR_FATHOM
+#include "tbprobe.h"
+#endif
+
+namespace Dagor::Tablebase {
+
+#ifdef DAGOR_FATHOM
+
+/// @brief The arguments Fathom describes a position with.
+struct Position {
+  std::uint64_t white;
+  std::uint64_t black;
+  std::array<std::uint64_t, Piece::all.size()> pieces;
+  unsigned halfMoves;
+  unsigned castling;
+  unsigned enPassant;
+  bool whiteToMove;
+
+  explicit Position(const GameState &state)
+      : white{state.forColor(Color::white).asUint()},
+        black{state.forColor(Color::black).asUint()},
+        pieces{},
+        halfMoves{state.uneventfulHalfMoves},
+        castling{state.castlingRights},
+        // Fathom numbers the squares like we do, a1 first, but has no
+        // square for “none”.
+        enPassant{state.enPassantSquare == Square::noSquare
+                      ? 0u
+                      : static_cast<unsigned>(state.enPassantSquare)},
+        whiteToMove{state.us() == Color::white} {
+    for (Piece::t piece : Piece::all) {
+      pieces[piece] = state.forPiece(piece).asUint();
+    }
+  }
+};
+
+/// @return the mutex around root probes, which Fathom does not allow in
+/// several threads at once. Probes inside the tree need none.
+std::mutex &rootMutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+bool init(const std::string &paths) {
+  return tb_init(paths.c_str()) && TB_LARGEST > 0;
+}
+
+int largest() { return static_cast<int>(TB_LARGEST); }
+
+bool probeWdl(const GameState &state, Wdl::t &wdl) {
+  if (state.occupancy().populationCount() == 2) {
+    wdl = Wdl::draw;
+    return true;
+  }
+  Position p{state};
+  unsigned result = tb_probe_wdl(
+      p.white, p.black, p.pieces[Piece::king], p.pieces[Piece::queen],
+      p.pieces[Piece::rook], p.pieces[Piece::bishop], p.pieces[Piece::knight],
+      p.pieces[Piece::pawn], p.halfMoves, p.castling, p.enPassant,
+      p.whiteToMove);
+  if (result == TB_RESULT_FAILED) return false;
+  wdl = static_cast<int>(result) - TB_DRAW;
+  return true;
+}
+
+/// @return a rank of the outcome of a root move, higher for better ones: a
+/// win is better the sooner it comes, a loss the later.
+int rootRank(unsigned result) {
+  int wdl = static_cast<int>(TB_GET_WDL(result)) - TB_DRAW;
+  int dtz = static_cast<int>(TB_GET_DTZ(result));
+  // DTZ values have 12 bits.
+  constexpr int longest = 1 << 12;
+  return wdl * longest + (wdl > 0 ? -dtz : wdl < 0 ? dtz : 0);
+}
+
+bool filterRootMoves(const GameState &state, std::vector<Move> &moves,
+                     Wdl::t &wdl) {
+  Position p{state};
+  std::array<unsigned, TB_MAX_MOVES> results{};
+  unsigned best = 0;
+  {
+    std::lock_guard<std::mutex> lock{rootMutex()};
+    best = tb_probe_root(
+        p.white, p.black, p.pieces[Piece::king], p.pieces[Piece::queen],
+        p.pieces[Piece::rook], p.pieces[Piece::bishop],
+        p.pieces[Piece::knight], p.pieces[Piece::pawn], p.halfMoves,
+        p.castling, p.enPassant, p.whiteToMove, results.data());
+  }
+  if (best == TB_RESULT_FAILED || best == TB_RESULT_CHECKMATE ||
+      best == TB_RESULT_STALEMATE) {
+    return false;
+  }
+  if (moves.empty()) return false;
+
+  constexpr std::array<Piece::t, 5> promotions = {
+      Piece::empty, Piece::queen, Piece::rook, Piece::bishop, Piece::knight};
+  std::vector<unsigned> outcomes;
+  outcomes.reserve(moves.size());
+  for (Move m : moves) {
+    auto result = std::find_if(results.begin(), results.end(), [&](unsigned r) {
+      return r == TB_RESULT_FAILED ||
+             (static_cast<Square::t>(TB_GET_FROM(r)) == m.start &&
+              static_cast<Square::t>(TB_GET_TO(r)) == m.end &&
+              promotions[TB_GET_PROMOTES(r)] == m.promotion);
+    });
+    if (result == results.end() || *result == TB_RESULT_FAILED) return false;
+    outcomes.push_back(*result);
+  }
+
+  unsigned bestOutcome = *std::max_element(
+      outcomes.begin(), outcomes.end(),
+      [](unsigned a, unsigned b) { return rootRank(a) < rootRank(b); });
+  std::vector<Move> kept;
+  for (std::size_t i = 0; i < moves.size(); i++) {
+    if (rootRank(outcomes[i]) == rootRank(bestOutcome)) {
+      kept.push_back(moves[i]);
+    }
+  }
+  moves = kept;
+  wdl = static_cast<int>(TB_GET_WDL(bestOutcome)) - TB_DRAW;
+  return true;
+}
+
+#else
+
+bool init(const std::string &) { return false; }
+
+int largest() { return 0; }
+
+bool probeWdl(const GameState &state, Wdl::t &wdl) {
+  if (state.occupancy().populationCount() != 2) return false;
+  wdl = Wdl::draw;
+  return true;
+}
+
+bool filterRootMoves(const GameState &, std::vector<Move> &, Wdl::t &) {
+  return false;
+}
+
+#endif
+
+}  // namespace Dagor::Tablebase
@@ -0,0 +1,51 @@
+#ifndef TABLEBASE_H
+#define TABLEBASE_H
+
+#include <string>
+#include <vector>
+
+#include "game_state.h"
+
+/// @brief Probes Syzygy endgame tablebases: `.rtbw` files with the outcome
+/// (win, draw or loss) and `.rtbz` files with the distance to the next
+/// capture or pawn move (DTZ) of every position with few pieces.
+///
+/// The files are read by Fathom (https://github.com/jdart1/Fathom, MIT
+/// license), which is not part of the repository: the Makefile builds it in
+/// if it finds it in `lib/fathom`. Builds without it find no tables.
+namespace Dagor::Tablebase {
+
+/// @brief The outcome for the side to move. Cursed wins and blessed losses
+/// are draws by the fifty move rule.
+namespace Wdl {
+using t = int;
+enum { loss = -2, blessedLoss = -1, draw = 0, cursedWin = 1, win = 2 };
+}  // namespace Wdl
+
+/// @brief Forgets all tables and looks for new ones in the directories of
+/// `paths`, separated by colons. An empty path or `<empty>` turns probing
+/// off.
+/// @return whether any tables were found.
+bool init(const std::string &paths);
+
+/// @return the most pieces (kings included) of any table found, or 0.
+int largest();
+
+/// @brief Probes the WDL tables. They only hold the outcome of the game
+/// right after a capture or pawn move, and know nothing about castling, so
+/// `state` must have neither a move since the last one nor castling rights.
+/// @return `false` if the tables do not cover the position.
+bool probeWdl(const GameState &state, Wdl::t &wdl);
+
+/// @brief Keeps only the moves of `moves` with the best outcome, and of
+/// those the ones that get to it the fastest, so that a won endgame is won
+/// before the fifty move rule, whatever the search makes of it. `wdl` is
+/// set to that outcome.
+/// @return `false`, with `moves` unchanged, if the tables do not cover the
+/// position and all its moves.
+bool filterRootMoves(const GameState &state, std::vector<Move> &moves,
+                     Wdl::t &wdl);
+
+}  // namespace Dagor::Tablebase
+
+#endif
@@ -1,14 +1,41 @@
 #include "test.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <sstream>
+#include <thread>
 
+#include "analyze.h"
+#include "bitbase.h"
 #include "bitboard.h"
+#include "book.h"
+#include "datagen.h"
+#include "eval.h"
 #include "game_state.h"
+#include "match.h"
+#include "nnue.h"
+#include "notation.h"
+#include "packed.h"
+#include "pawns.h"
+#include "pgn.h"
+#include "search.h"
+#include "suite.h"
+#include "tablebase.h"
+#include "tokens.h"
+#include "tune.h"
 #include "types.h"
+#include "uci.h"
 
 namespace Dagor::Test {
 
+using namespace std::string_literals;
+using namespace std::string_view_literals;
+
 static unsigned tests = 0;
 static unsigned failures = 0;
 
@@ -194,6 +221,96 @@ void legalMoves() {
                 std::vector{Move{"d5d6"}, Move{"a5a6"}, Move{"a5b6"},
                             Move{"a5b5"}, Move{"a5a4"}},
                 "En passant discovered check");
+
+  GameState pinned{"8/8/8/8/8/k7/8/K1Rr4 w - - 0 1"};
+  std::vector<Move> reused = GameState{}.generateLegalMoves();
+  pinned.generateLegalMoves(reused);
+  assertEquals(reused, pinned.generateLegalMoves(),
+               "Moves generated into a used list replace its contents");
+}
+
+/// @return whether `move` gives check in `fen`, as `givesCheck` sees it.
+bool givesCheck(std::string_view fen, std::string_view move) {
+  GameState state{fen};
+  std::vector<Move> moves;
+  CheckInfo checks{};
+  state.generateLegalMoves(moves, checks);
+  return state.givesCheck(Move{move}, checks);
+}
+
+void checks() {
+  header("Checks");
+  GameState doubleCheck{"4r2k/8/8/8/1b6/8/8/4K3 w - - 0 1"};
+  std::vector<Move> moves;
+  CheckInfo info{};
+  doubleCheck.generateLegalMoves(moves, info);
+  assertEquals(info.checkers, BitBoards::single(Square::e8) |
+                                  BitBoards::single(Square::b4),
+               "The move generator finds the checking pieces");
+  assertEquals(givesCheck("4k3/8/8/3p4/4P3/8/8/4R1K1 w - - 0 1", "e4d5"),
+               true, "Moving off a line discovers check");
+  assertEquals(givesCheck("4k3/8/8/3p4/4P3/8/8/4R1K1 w - - 0 1", "e4e5"),
+               false, "Moving along a line keeps it blocked");
+  assertEquals(givesCheck("8/8/8/R2pP2k/8/8/8/4K3 w - d6 0 1", "e5d6"),
+               true, "En passant can discover check along the rank");
+  assertEquals(givesCheck("5k2/8/8/8/8/8/8/4K2R w K - 0 1", "e1g1"), true,
+               "The rook gives check after castling");
+  assertEquals(givesCheck("8/6P1/8/8/8/8/8/K5k1 w - - 0 1", "g7g8q"), true,
+               "A promoted queen sees through the square it came from");
+  assertEquals(givesCheck("8/6P1/8/8/8/8/8/K5k1 w - - 0 1", "g7g8n"), false,
+               "A promoted knight does not");
+
+  std::mt19937 generator{7};
+  int wrong = 0;
+  for (std::string_view fen :
+       {GameState::startingPosition,
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"s,
+        "n1n5/PPPk4/8/8/8/8/4Kppp/5N1N b - - 0 1"s}) {
+    for (int game = 0; game < 20; game++) {
+      GameState state{fen};
+      for (int ply = 0; ply < 80; ply++) {
+        state.generateLegalMoves(moves, info);
+        if (moves.empty()) break;
+        wrong += info.checkers != state.checkers();
+        for (Move m : moves) {
+          bool predicted = state.givesCheck(m, info);
+          state.executeMove(m);
+          wrong += predicted != state.isCheck();
+          state.undoMove();
+        }
+        std::uniform_int_distribution<std::size_t> pick(0, moves.size() - 1);
+        state.executeMove(moves[pick(generator)]);
+      }
+    }
+  }
+  assertEquals(wrong, 0, "givesCheck agrees with making the move");
+}
+
+void attackMaps() {
+  header("Attack Maps");
+  GameState start{};
+  assertEquals(start.attacks().byPiece[Color::white][Piece::pawn],
+               {0xff0000}, "Pawn attacks are computed set-wise");
+  assertEquals(start.attacks().mobility[Color::black][Piece::knight], 4,
+               "Mobility counts the safe squares reached");
+  assertMoveGen("8/8/8/8/8/7k/8/1K5r w - - 0 1",
+                std::vector{Move{"b1a2"}, Move{"b1b2"}, Move{"b1c2"}},
+                "The king cannot step back along a checking ray");
+
+  assertEquals(GameState{"4k3/8/8/3p4/8/8/8/3QK3 w - - 0 1"}.see(Move{"d1d5"}),
+               100, "Capturing an undefended piece wins it");
+  assertEquals(
+      GameState{"4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1"}.see(Move{"d1d5"}), -800,
+      "Capturing a defended pawn with the queen loses material");
+  assertEquals(
+      GameState{"4k3/8/3p4/4n3/8/5N2/8/4K3 w - - 0 1"}.see(Move{"f3e5"}), 0,
+      "Trading pieces is even");
+  assertEquals(
+      GameState{"3rk3/8/8/3p4/8/8/3R4/3RK3 w - - 0 1"}.see(Move{"d2d5"}), 100,
+      "A slider behind the capturing piece joins the exchange");
+  assertEquals(
+      GameState{"3rk3/8/8/3p4/8/8/8/3RK3 w - - 0 1"}.see(Move{"d1d5"}), -400,
+      "Defenders behind the target are seen");
 }
 
 void assertMoveMaker(std::string_view start, std::string_view move,
@@ -234,10 +351,829 @@ void makeMove() {
                   "Moving a king removes castling rights");
   assertMoveMaker("8/8/8/8/2Pp4/8/8/8 b - c3 0 1", "d4c3",
                   "8/8/8/8/8/2p5/8/8 w - - 0 1", "en passant capture");
+  assertMoveMaker("4k3/8/8/8/3p4/8/4P3/4K3 w - - 0 1", "e2e4",
+                  "4k3/8/8/8/3pP3/8/8/4K3 b - e3 0 1",
+                  "A double step allows en passant");
   assertMoveMaker("8/8/8/8/8/8/8/R3K3 w Q - 0 1", "e1c1",
                   "8/8/8/8/8/8/8/2KR4 b - - 1 1", "white queen-side castle");
 }
 
+void repetitions() {
+  header("Repetitions");
+  GameState state{};
+  for (std::string_view move : {"g1f3"sv, "g8f6"sv, "f3g1"sv}) {
+    state.executeMove(Move{move});
+  }
+  assertEquals(state.hasUpcomingRepetition(4), true,
+               "Moving the knight back repeats a position");
+  assertEquals(state.hasUpcomingRepetition(3), false,
+               "Only positions after the root count as upcoming");
+  state.executeMove(Move{"f6g8"});
+  assertEquals(state.repetitions(), 1, "The start position is repeated");
+  assertEquals(state.isRepetition(5), true,
+               "One repetition within the search is a draw");
+  assertEquals(state.isRepetition(4), false,
+               "Positions before the root need to occur twice");
+  for (std::string_view move : {"g1f3"sv, "g8f6"sv, "f3g1"sv, "f6g8"sv}) {
+    state.executeMove(Move{move});
+  }
+  assertEquals(state.repetitions() == 2 && state.isRepetition(0), true,
+               "Threefold repetition is a draw");
+  state.undoMove();
+  state.executeMove(Move{"f6g8"});
+  assertEquals(state.repetitions(), 2, "Undoing a move drops its key");
+  state.executeMove(Move{"e2e4"});
+  state.executeMove(Move{"e7e5"});
+  assertEquals(state.repetitions() == 0 && !state.hasUpcomingRepetition(99),
+               true, "Pawn moves end the search for repetitions");
+}
+
+void evaluation() {
+  header("Evaluation");
+  Score::t score = Score::make(-5, 7) + Score::make(3, -20);
+  assertEquals(Score::middleGame(score), -2, "Middle game half of a score");
+  assertEquals(Score::endGame(score), -13, "End game half of a score");
+
+  assertEquals(Eval::eval(GameState{}), 0, "Starting position is balanced");
+  assertEquals(GameState{}.phase, Eval::fullPhase,
+               "Starting position is in the opening phase");
+  assertEquals(Eval::eval(GameState{"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"}),
+               Eval::eval(GameState{"4k3/4p3/8/8/8/8/8/4K3 b - - 0 1"}),
+               "Evaluation is symmetric");
+  assertEquals(
+      Eval::eval(GameState{"8/8/8/4k3/8/8/4P3/4K3 b - - 0 1"}) >
+          Eval::eval(GameState{"4k3/8/8/8/8/8/4P3/4K3 b - - 0 1"}),
+      true, "In the end game, the king is drawn to the center");
+
+  GameState s{};
+  for (auto m : {"e2e4", "d7d5", "e4d5", "d8d5", "b1c3", "d5a2", "a1a2"}) {
+    s.executeMove(Move{m});
+  }
+  GameState fresh{"rnb1kbnr/ppp1pppp/8/8/8/2N5/RPPP1PPP/2BQKBNR b Kkq - 0 4"};
+  assertEquals(s.pieceSquareScore, fresh.pieceSquareScore,
+               "Piece-square score is updated incrementally");
+  assertEquals(s.phase, fresh.phase, "Game phase is updated incrementally");
+  assertEquals(s.pawnKey, fresh.pawnKey, "Pawn key is updated incrementally");
+  assertEquals(s.hash, fresh.hash, "Position hash is updated incrementally");
+
+  GameState a{}, b{};
+  for (auto m : {"g1f3", "b8c6", "b1c3"}) a.executeMove(Move{m});
+  for (auto m : {"b1c3", "b8c6", "g1f3"}) b.executeMove(Move{m});
+  assertEquals(a.hash, b.hash, "Transpositions have the same hash");
+  assertEquals(
+      GameState{}.hash ==
+          GameState{"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR b KQkq - 0 1"}
+              .hash,
+      false, "The side to move is part of the hash");
+
+  Eval::EvalCache cache{};
+  assertEquals(cache.probe(a), Eval::eval(a), "The cache returns evaluations");
+  cache.probe(b);
+  assertEquals(cache.hits, static_cast<std::uint64_t>(1),
+               "Transpositions are evaluated only once");
+}
+
+void pawnStructure() {
+  header("Pawn Structure");
+  Eval::PawnTable table{};
+  GameState lonely{"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"};
+  assertEquals(table.probe(lonely).score, Score::make(-5, -5),
+               "A lonely pawn is passed and isolated");
+  assertEquals(table.probe(GameState{"4k3/8/8/8/8/4P3/4P3/4K3 w - - 0 1"}).score,
+               Score::make(-15, -20), "Doubled pawns are penalized");
+  assertEquals(
+      table.probe(GameState{"4k3/8/8/4p3/2P5/3P4/8/4K3 w - - 0 1"}).score,
+      Score::make(17, 40), "A pawn that cannot be defended is backward");
+  assertEquals(table.probe(GameState{}).shelter[Color::black][Coord::g],
+               static_cast<std::int16_t>(36),
+               "Pawns in front of the king shelter it");
+
+  table.resetStatistics();
+  table.probe(GameState{"4k3/pp6/8/8/8/8/6PP/4K3 w - - 0 1"});
+  table.probe(GameState{"4k3/pp6/8/8/8/8/6PP/4K3 w - - 0 1"});
+  assertEquals(table.hits, static_cast<std::uint64_t>(1),
+               "Repeated pawn structures are cached");
+}
+
+void uciPositions() {
+  header("UCI Positions");
+  Tokenizer tokens{"  setoption name  Eval File\tvalue a b \n"};
+  assertEquals(tokens.next(), "setoption"sv, "Words are split at whitespace");
+  tokens.next();
+  assertEquals(tokens.next(), "Eval"sv, "Repeated whitespace is skipped");
+  tokens.next();
+  tokens.next();
+  assertEquals(tokens.remainder(), "a b"sv, "The rest of a line is trimmed");
+  assertEquals(tokens.done(), true, "The end of a line is detected");
+  assertEquals(GameState{"4k3/8/8/8/8/8/4P3/4K3 w - -"},
+               GameState{"4k3/8/8/8/8/8/4P3/4K3 w - - 0 1"},
+               "EPD records without move counters are read");
+
+  UCI::Position position{};
+  UCI::setPosition("position startpos moves e2e4 e7e5", position);
+  UCI::setPosition("position startpos moves e2e4 e7e5 g1f3", position);
+  GameState expected{};
+  for (auto m : {"e2e4", "e7e5", "g1f3"}) expected.executeMove(Move{m});
+  assertEquals(position.state, expected, "New moves are played on top");
+  assertEquals(position.state.undoStack.size(), std::size_t{3},
+               "Old moves are not replayed");
+
+  UCI::setPosition("position startpos moves e2e4 c7c5", position);
+  assertEquals(position.state,
+               GameState{"rnbqkbnr/pp1ppppp/8/2p5/4P3/8/PPPP1PPP/RNBQKBNR w "
+                         "KQkq c6 0 2"},
+               "Diverging moves are taken back");
+
+  UCI::setPosition("position fen 4k3/8/8/8/8/8/4P3/4K3 w - - 0 1 moves e2e4",
+                   position);
+  assertEquals(position.state,
+               GameState{"4k3/8/8/8/4P3/8/8/4K3 b - e3 0 1"},
+               "A different start position is set up from scratch");
+}
+
+void searchAndAnalysis() {
+  header("Search");
+  GameState mateInOne{"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"};
+  Search::Result result = Search::search(mateInOne, Search::Limits{3});
+  assertEquals(result.bestMove, Move{"a1a8"}, "A mate in one is found");
+  assertEquals(result.score, Search::mate - 1, "Mate scores count plies");
+  assertEquals(result.depth, 3, "The search iterates up to its depth");
+  assertEquals(result.pv, std::vector<Move>{Move{"a1a8"}},
+               "The principal variation ends with the mate");
+  assertEquals(result.statistics.iterationNodes.size(), std::size_t{3},
+               "Nodes are counted per iteration");
+  assertEquals(mateInOne, GameState{"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"},
+               "The searched position is left unchanged");
+  assertEquals(Search::search(mateInOne, Search::Limits{0}).depth, 1,
+               "Depths below one search one ply");
+  Search::Limits deep{1000};
+  deep.nodes = 2000;
+  assertEquals(Search::search(mateInOne, deep).bestMove, Move{"a1a8"},
+               "Depths beyond the frames are cut to them");
+  Search::Limits several{3};
+  several.multiPv = 3;
+  GameState start{};
+  Search::Result lines = Search::search(start, several);
+  assertEquals(lines.lines.size(), std::size_t{3}, "MultiPV finds 3 lines");
+  assertEquals(lines.lines[0].score >= lines.lines[1].score &&
+                   lines.lines[1].score >= lines.lines[2].score &&
+                   !(lines.lines[0].pv.front() == lines.lines[1].pv.front()),
+               true, "The lines are different moves, best first");
+  assertEquals(lines.score, Search::search(start, Search::Limits{3}).score,
+               "The best line scores as without MultiPV");
+  several.multiPv = 1;
+  several.searchMoves = {Move{"a2a3"}, Move{"h2h3"}};
+  Move restricted = Search::search(start, several).bestMove;
+  assertEquals(restricted == Move{"a2a3"} || restricted == Move{"h2h3"}, true,
+               "Only the search moves are searched");
+  Search::Limits budget{};
+  budget.nodes = 5000;
+  Search::history().clear();
+  Search::Result once = Search::search(start, budget);
+  const std::vector<std::int16_t> &learned = Search::history().continuation[0];
+  assertEquals(std::any_of(learned.begin(), learned.end(),
+                           [](std::int16_t score) { return score != 0; }),
+               true, "The history carries over to the next search");
+  Search::history().clear();
+  Search::Result again = Search::search(start, budget);
+  assertEquals(once.nodes, std::uint64_t{5000}, "Node limits are exact");
+  assertEquals(once.bestMove == again.bestMove && once.depth == again.depth,
+               true, "Searches after clearing the history are reproducible");
+  GameState mateInTwo{"7k/8/5K2/8/8/8/8/Q7 w - - 0 1"};
+  Search::Limits mateLimits{};
+  mateLimits.mate = 1;
+  assertEquals(Search::search(mateInTwo, mateLimits).score, 0,
+               "There is no mate in one");
+  mateLimits.mate = 3;
+  Search::Result mated = Search::search(mateInTwo, mateLimits);
+  assertEquals(mated.score, Search::mate - 3, "The mate in two is found");
+  assertEquals(mated.depth, 3, "The mate search stops at the first mate");
+  GameState stalemate{"7k/5Q2/6K1/8/8/8/8/8 b - - 0 1"};
+  assertEquals(Search::search(stalemate, Search::Limits{3}).bestMove, nullMove,
+               "There is no best move in stalemate");
+
+  std::stringstream in{
+      "6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#;\n\n"
+      "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq -\n"
+      "7k/5Q2/6K1/8/8/8/8/8 b - -\n"};
+  std::stringstream out{};
+  Analyze::analyze(in, out, Search::Limits{2}, 3);
+  std::string first, second, third;
+  std::getline(out, first);
+  std::getline(out, second);
+  std::getline(out, third);
+  assertEquals(first.substr(0, 38),
+               "6k1/5ppp/8/8/8/8/8/R5K1 w - - bestmove"s,
+               "Analysis results come in input order");
+  assertEquals(third, "7k/5Q2/6K1/8/8/8/8/8 b - - bestmove 0000 score 0 "
+                      "depth 0 nodes 1"s,
+               "Analysis reports positions without moves");
+
+  std::stringstream session{
+      "debug on\n"
+      "position fen 6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1\n"
+      "go movetime 100\n"};
+  std::stringstream reply{};
+  UCI::universalChessInterface(session, reply);
+  std::string output = reply.str();
+  assertEquals(output.rfind("info depth 1 seldepth 1 score cp ", 0),
+               std::size_t{0}, "Each iteration is reported");
+  assertEquals(output.find("info depth 2 seldepth 2 score mate 1 nodes ") !=
+                   std::string::npos,
+               true, "Mates are reported in moves");
+  assertEquals(output.find(" pv a1a8\n") != std::string::npos, true,
+               "Reports end with the principal variation");
+  assertEquals(output.find("info string beta cutoffs") != std::string::npos,
+               true, "Debug mode adds the search statistics");
+
+  std::stringstream analysis{
+      "setoption name MultiPV value 2\n"
+      "position fen 6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1\n"
+      "go movetime 50 searchmoves g1f1 g1g2 a1a2\n"};
+  reply.str("");
+  UCI::universalChessInterface(analysis, reply);
+  output = reply.str();
+  assertEquals(output.find(" multipv 2 ") != std::string::npos &&
+                   output.find("bestmove a1a8") == std::string::npos,
+               true, "go searchmoves reports several lines");
+
+  std::stringstream fixedDepth{"position startpos\ngo depth 2\n"};
+  reply.str("");
+  UCI::universalChessInterface(fixedDepth, reply);
+  output = reply.str();
+  assertEquals(output.find("info depth 2 ") != std::string::npos &&
+                   output.find("info depth 3 ") == std::string::npos,
+               true, "go depth is respected");
+
+  std::stringstream pondering{
+      "position startpos moves e2e4\n"
+      "go ponder wtime 60000 btime 60000\n"
+      "isready\n"
+      "stop\n"};
+  reply.str("");
+  UCI::universalChessInterface(pondering, reply);
+  output = reply.str();
+  std::size_t ready = output.find("readyok\n");
+  std::size_t answer = output.find("bestmove ");
+  assertEquals(ready != std::string::npos && answer != std::string::npos &&
+                   ready < answer,
+               true, "Commands are read while pondering, until stop");
+}
+
+void notation() {
+  header("Notation");
+  GameState kiwipete{
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"};
+  assertEquals(Notation::san(kiwipete, Move{"e1g1"}), "O-O"s,
+               "Castling is written with letters");
+  assertEquals(Notation::san(kiwipete, Move{"e5f7"}), "Nxf7"s,
+               "Captures are marked");
+  assertEquals(Notation::san(kiwipete, Move{"d5e6"}), "dxe6"s,
+               "Capturing pawns name their file");
+  assertEquals(Notation::san(GameState{"k7/8/8/8/8/8/4K3/R6R w - - 0 1"},
+                             Move{"a1e1"}),
+               "Rae1"s, "Ambiguous moves name their file");
+  assertEquals(Notation::san(GameState{"7k/8/8/8/R7/8/8/R3K3 w - - 0 1"},
+                             Move{"a1a2"}),
+               "R1a2"s, "Or their rank, if the file is not enough");
+  assertEquals(Notation::san(GameState{"6k1/5ppp/8/8/8/8/8/R5K1 w - - 0 1"},
+                             Move{"a1a8"}),
+               "Ra8#"s, "Mates are marked");
+  assertEquals(Notation::parse(kiwipete, "Bxa6!"), Move{"e2a6"},
+               "Annotations are ignored when reading moves");
+  assertEquals(Notation::parse(kiwipete, "e1c1"), Move{"e1c1"},
+               "UCI moves are read as well");
+  assertEquals(Notation::parse(kiwipete, "Ke3"), nullMove,
+               "Illegal moves are not read");
+  assertEquals(Notation::parse(kiwipete, "Nc3b1"), Move{"c3b1"},
+               "Unneeded hints are accepted");
+  assertEquals(Notation::parse(GameState{"k7/8/8/8/8/8/4K3/R6R w - - 0 1"},
+                               "Re1"),
+               nullMove, "Ambiguous moves are not read");
+  assertEquals(Notation::parse(GameState{"8/4P1k1/8/8/8/8/8/4K3 w - - 0 1"},
+                               "e8N+"),
+               Move{"e7e8n"}, "Promotions may be written without `=`");
+
+  Suite::Problem problem =
+      Suite::parse("6k1/5ppp/8/8/8/8/8/R5K1 w - - bm Ra8#; id \"mate 1\";");
+  assertEquals(problem.id, "mate 1"s, "EPD ids are read");
+  assertEquals(problem.isSolvedBy(Move{"a1a8"}), true,
+               "The best move solves a problem");
+  assertEquals(problem.isSolvedBy(Move{"a1a7"}), false,
+               "Other moves do not solve a problem");
+}
+
+void portableGameNotation() {
+  header("Portable Game Notation");
+  std::stringstream file{
+      "[Event \"Test \\\"quoted\\\"\"]\n"
+      "[White \"A\"]\n"
+      "% an escaped line [not a tag]\n"
+      "\n"
+      "1. e4 {a comment (with parentheses)} e5 2.Nf3 $1 Nc6 (2... d6 3. d4)\n"
+      "3. Bb5 a6 ; rest of line 4. Qh5\n"
+      "4. O-O 1-0\n"
+      "\n"
+      "[FEN \"8/4P1k1/8/8/8/8/8/4K3 w - - 0 1\"]\n"
+      "[SetUp \"1\"]\n"
+      "1. e8=Q Kf6 2. Qe4 *\n"
+      "1. d4 Nf6 2. Bg5 Ke7 3. c4\n"};
+  Pgn::Reader reader{file, 7};
+  Pgn::Game game{};
+  assertEquals(reader.next(game), true, "Games are read");
+  assertEquals(game.tag("Event"), "Test \"quoted\""s, "Tags are read");
+  assertEquals(game.tags.size(), std::size_t{2}, "Escaped lines are skipped");
+  assertEquals(game.moves.size(), std::size_t{7},
+               "Comments, variations and NAGs are skipped");
+  assertEquals(game.moves.back(), Move{"e1g1"}, "Castling is read");
+  assertEquals(game.result, "1-0"s, "Results are read");
+  assertEquals(reader.next(game), true, "Several games are read");
+  assertEquals(game.moves.size(), std::size_t{3},
+               "Games start from their FEN tag");
+  assertEquals(game.moves.front(), Move{"e7e8q"}, "Promotions are read");
+  assertEquals(reader.next(game), true, "Games without tags are read");
+  assertEquals(game.error, "Ke7"s, "Illegal moves are reported");
+  assertEquals(game.moves.size(), std::size_t{3},
+               "Moves stop at an illegal one");
+  assertEquals(reader.next(game), false, "The end of the file is noticed");
+
+  std::stringstream again{"1. f3 e5 2. g4 Qh4# 0-1"};
+  Pgn::Reader replayed{again};
+  replayed.next(game);
+  int quiet = 0;
+  Pgn::replay(game, [&](GameState &state, Move move) {
+    quiet += !state.isCheck() && !state.isCapture(move);
+  });
+  assertEquals(quiet, 4, "Games can be replayed move by move");
+}
+
+void matchStatistics() {
+  header("Match Statistics");
+  Match::Score even{10, 20, 10};
+  assertEquals(Match::elo(even).first, 0.0, "Even results mean equal strength");
+  assertEquals(Match::logLikelihoodRatio(even, 0, 5) < 0, true,
+               "Even results favour the null hypothesis");
+  Match::Score ahead{30, 40, 20};
+  assertEquals(std::round(Match::elo(ahead).first * 100) / 100, 38.76,
+               "The Elo difference follows from the mean score");
+  assertEquals(
+      std::round(Match::logLikelihoodRatio(ahead, 0, 10) * 1000) / 1000, 0.461,
+      "The log-likelihood ratio follows the trinomial model");
+}
+
+void packedPositions() {
+  header("Packed Positions");
+  GameState kiwipete{
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 3 1"};
+  GameState unpacked{};
+  Packed::PackedPosition packed =
+      Packed::pack(kiwipete, -25, Packed::Result::whiteWins, Move{"e2a6"});
+  Packed::unpack(packed, unpacked);
+  assertEquals(unpacked, kiwipete, "Positions survive packing");
+  assertEquals(Packed::moveOf(packed), Move{"e2a6"}, "Moves survive packing");
+  GameState enPassant{"4k3/8/8/3pP3/8/8/8/4K3 w - d6 0 1"};
+  Packed::unpack(Packed::pack(enPassant, 0, Packed::Result::draw), unpacked);
+  assertEquals(unpacked, enPassant, "En passant squares survive packing");
+
+  std::string path = "test.packed";
+  std::remove(path.c_str());
+  {
+    Packed::Writer writer{path};
+    for (int i = 0; i < 3; i++) {
+      writer.write(Packed::pack(kiwipete, static_cast<std::int16_t>(i),
+                                Packed::Result::draw));
+    }
+    assertEquals(writer.flush(), true, "Written blocks are reported");
+  }
+  Packed::Writer nowhere{"no-such-directory/test.packed"};
+  nowhere.write(packed);
+  assertEquals(nowhere.flush(), false, "Failed writes are reported");
+  Packed::MappedFile file{};
+  assertEquals(file.open(path), true, "Packed files can be mapped");
+  assertEquals(file.size(), std::size_t{3}, "Mapped files hold all records");
+  assertEquals(static_cast<int>(file.begin()[2].score), 2,
+               "Records are read in the order they were written");
+  std::remove(path.c_str());
+
+  std::vector<std::thread> threads;
+  for (int id : {1, 2}) {
+    threads.emplace_back([&, id]() {
+      Packed::Writer writer{path};
+      for (std::size_t i = 0; i < 2 * Packed::Writer::bufferSize; i++) {
+        writer.write(Packed::pack(kiwipete, static_cast<std::int16_t>(id),
+                                  Packed::Result::draw));
+      }
+    });
+  }
+  for (std::thread &thread : threads) thread.join();
+  bool whole = file.open(path) &&
+               file.size() == 4 * Packed::Writer::bufferSize;
+  for (std::size_t i = 0; whole && i < file.size(); i++) {
+    std::size_t block = i - i % Packed::Writer::bufferSize;
+    whole = file.begin()[i].score == file.begin()[block].score;
+  }
+  assertEquals(whole, true, "Writers of one file append whole blocks");
+  std::remove(path.c_str());
+}
+
+void appendBookEntry(std::string &file, std::uint64_t key,
+                     std::uint16_t move, std::uint16_t weight) {
+  for (int shift = 56; shift >= 0; shift -= 8) {
+    file += static_cast<char>(key >> shift & 0xff);
+  }
+  for (std::uint16_t value : {move, weight}) {
+    file += static_cast<char>(value >> 8);
+    file += static_cast<char>(value & 0xff);
+  }
+  file.append(4, '\0');
+}
+
+void openingBook() {
+  header("Opening Book");
+  GameState state{};
+  assertEquals(Book::key(state), std::uint64_t{0x463b96181691fc9c},
+               "The start position has the Polyglot key");
+  state.executeMove(Move{"e2e4"});
+  assertEquals(Book::key(state), std::uint64_t{0x823c9b50fd114196},
+               "Moves change the Polyglot key");
+  for (auto move : {"d7d5", "e4e5", "f7f5"}) {
+    state.executeMove(Move{move});
+  }
+  assertEquals(Book::key(state), std::uint64_t{0x22a48b5a8e47ff78},
+               "En passant counts if a pawn can capture");
+  for (auto move : {"e1e2", "e8f7"}) {
+    state.executeMove(Move{move});
+  }
+  assertEquals(Book::key(state), std::uint64_t{0x00fdd303c946bdd9},
+               "Lost castling rights change the Polyglot key");
+
+  GameState start{};
+  GameState castling{"r3k2r/8/8/8/8/8/8/R3K2R w KQkq - 0 1"};
+  // Moves are `start << 6 | end`, entries are sorted by key.
+  std::string startEntries;
+  appendBookEntry(startEntries, Book::key(start), 12 << 6 | 28, 3);  // e2e4
+  appendBookEntry(startEntries, Book::key(start), 11 << 6 | 27, 1);  // d2d4
+  appendBookEntry(startEntries, Book::key(start), 12 << 6 | 36, 9);  // e2e5
+  std::string castlingEntries;
+  appendBookEntry(castlingEntries, Book::key(castling), 4 << 6 | 7, 1);
+  std::string file = Book::key(start) < Book::key(castling)
+                         ? startEntries + castlingEntries
+                         : castlingEntries + startEntries;
+  std::string path = "test-book.bin";
+  std::ofstream{path, std::ios::binary} << file;
+  Book::Book book{};
+  assertEquals(book.open(path), true, "Books can be opened");
+  auto moves = book.moves(start);
+  assertEquals(moves.size(), std::size_t{2}, "Illegal book moves are dropped");
+  assertEquals(book.moves(castling).front().first, Move{"e1g1"},
+               "Castling is read from the king taking the rook");
+  std::mt19937_64 generator{1};
+  int kingPawn = 0;
+  for (int i = 0; i < 400; i++) {
+    kingPawn += book.pick(start, generator) == Move{"e2e4"};
+  }
+  assertEquals(kingPawn > 250 && kingPawn < 350, true,
+               "Moves are picked by weight");
+  assertEquals(book.pick(state, generator), nullMove,
+               "Positions outside the book have no move");
+
+  std::string options =
+      "setoption name BookFile value " + path +
+      "\nsetoption name OwnBook value true\nposition startpos\n";
+  std::stringstream booked{options + "go wtime 60000 btime 60000\n"};
+  std::stringstream reply;
+  UCI::universalChessInterface(booked, reply);
+  assertEquals(reply.str().find("info depth") == std::string::npos &&
+                   reply.str().find("bestmove ") != std::string::npos,
+               true, "go plays book moves without searching");
+  std::stringstream pondering{options +
+                              "go ponder wtime 60000 btime 60000\n"
+                              "isready\nstop\n"};
+  reply.str("");
+  UCI::universalChessInterface(pondering, reply);
+  std::string output = reply.str();
+  std::size_t ready = output.find("readyok\n");
+  assertEquals(ready != std::string::npos &&
+                   ready < output.find("bestmove "),
+               true, "go ponder waits for stop even with a book move");
+  book.close();
+  std::remove(path.c_str());
+}
+
+void tablebases() {
+  header("Tablebases");
+  assertEquals(Tablebase::init("<empty>"), false, "Probing can be turned off");
+  GameState bare{"8/8/8/8/8/8/8/K6k w - - 0 1"};
+  Tablebase::Wdl::t wdl = Tablebase::Wdl::win;
+  assertEquals(Tablebase::probeWdl(bare, wdl) && wdl == Tablebase::Wdl::draw,
+               true, "Two kings are a draw without any table");
+  GameState hanging{"8/8/8/8/8/8/6k1/KQ5q w - - 0 1"};
+  wdl = Tablebase::Wdl::draw;
+  assertEquals(Tablebase::probeWdl(hanging, wdl), false,
+               "Missing tables fail the probe");
+  std::vector<Move> moves = hanging.generateLegalMoves();
+  std::size_t count = moves.size();
+  assertEquals(!Tablebase::filterRootMoves(hanging, moves, wdl) &&
+                   moves.size() == count,
+               true, "Root moves stay without tables");
+  Search::Limits limits{};
+  limits.depth = 3;
+  assertEquals(Search::search(hanging, limits).statistics.tablebaseHits,
+               std::uint64_t{0}, "The search probes nothing without tables");
+}
+
+/// @brief Compares the Syzygy tables of KQK, KRK and KPK in the directory
+/// `SYZYGY_PATH` with the bitbases, position by position. The tables are
+/// not part of the repository, so without the variable nothing is compared;
+/// with it, the build needs Fathom to read them.
+void syzygyTables() {
+  header("Syzygy Tables");
+  const char* path = std::getenv("SYZYGY_PATH");
+  if (path == nullptr) {
+    std::cout << "skipped: set SYZYGY_PATH to a directory with KQvK, KRvK "
+                 "and KPvK\n";
+    return;
+  }
+  assertEquals(Tablebase::init(path) && Tablebase::largest() >= 3, true,
+               "The tables are found");
+  std::ostringstream timings;
+  assertEquals(Bitbase::run(".", std::max(1u, std::thread::hardware_concurrency()),
+                            timings) &&
+                   Bitbase::load(".") == Bitbase::Endgame::all.size(),
+               true, "The bitbases to compare with are computed");
+  int positions = 0;
+  int wdlAgreed = 0;
+  int filtered = 0;
+  int filterAgreed = 0;
+  GameState state{};
+  for (Piece::t piece : {Piece::queen, Piece::rook, Piece::pawn}) {
+    for (Square::t white = 0; white < Square::size; white++) {
+      for (Square::t black = 0; black < Square::size; black++) {
+        if (white == black || MoveTables::kingMoves(white).isSet(black)) {
+          continue;
+        }
+        for (Square::t other = 0; other < Square::size; other++) {
+          if (other == white || other == black) continue;
+          if (piece == Piece::pawn &&
+              (Square::rank(other) == 0 || Square::rank(other) == 7)) {
+            continue;
+          }
+          for (Color::t next : {Color::white, Color::black}) {
+            state.clear();
+            state.set(white, Piece::king, Color::white);
+            state.set(black, Piece::king, Color::black);
+            state.set(other, piece, Color::white);
+            state.setUp(next, CastlingRights::none, Square::noSquare, 0);
+            // The side that is not to move must not be in check.
+            Square::t passive = next == Color::white ? black : white;
+            if (!state.getAttacks(passive, state.them()).isEmpty()) continue;
+
+            bool strongWins = false;
+            Bitbase::probe(state, strongWins);
+            Tablebase::Wdl::t expected =
+                !strongWins ? Tablebase::Wdl::draw
+                : next == Color::white ? Tablebase::Wdl::win
+                                       : Tablebase::Wdl::loss;
+            Tablebase::Wdl::t wdl = Tablebase::Wdl::draw;
+            positions++;
+            wdlAgreed += Tablebase::probeWdl(state, wdl) && wdl == expected;
+            if (positions % 61 != 0) continue;
+            std::vector<Move> moves = state.generateLegalMoves();
+            if (moves.empty()) continue;
+
+            // The root filter knows the outcome, and every move it keeps
+            // keeps a win.
+            filtered++;
+            bool kept = Tablebase::filterRootMoves(state, moves, wdl) &&
+                        wdl == expected && !moves.empty();
+            for (Move m : moves) {
+              if (expected != Tablebase::Wdl::win) break;
+              state.executeMove(m);
+              bool stillWins = false;
+              Bitbase::probe(state, stillWins);
+              kept = kept && stillWins;
+              state.undoMove();
+            }
+            filterAgreed += kept;
+          }
+        }
+      }
+    }
+  }
+  assertEquals(wdlAgreed, positions, "WDL probes agree with the bitbases");
+  assertEquals(filterAgreed, filtered,
+               "Root moves keep the outcome, and won endgames won");
+
+  // Winning the rook leaves a table position right after the capture.
+  GameState rook{"k7/8/8/8/3Q3r/2K5/8/8 w - - 0 1"};
+  Search::Limits limits{};
+  limits.depth = 3;
+  Search::Result result = Search::search(rook, limits);
+  assertEquals(result.statistics.tablebaseHits > 0 &&
+                   result.bestMove == Move{"d4h4"} &&
+                   result.score > Search::tablebaseWin - Search::maxDepth,
+               true, "The search scores table positions as won");
+  Tablebase::init("");
+  for (Bitbase::Endgame::t endgame : Bitbase::Endgame::all) {
+    std::remove((Bitbase::name(endgame) + ".bb").c_str());
+  }
+  Bitbase::load(".");
+}
+
+/// @return whether the side with the pieces wins, going by the table entries
+/// of the positions after each legal move.
+bool winsByMoves(GameState& state) {
+  bool strongToMove = state.forColor(state.us()).populationCount() > 1;
+  std::vector<Move> moves = state.generateLegalMoves();
+  if (moves.empty()) return !strongToMove && state.isCheck();
+  for (Move move : moves) {
+    state.executeMove(move);
+    bool wins = false;
+    // Captures and minor promotions leave drawn endgames.
+    bool covered = Bitbase::probe(state, wins);
+    state.undoMove();
+    if (strongToMove && covered && wins) return true;
+    if (!strongToMove && !(covered && wins)) return false;
+  }
+  return !strongToMove;
+}
+
+void bitbases() {
+  header("Bitbases");
+  assertEquals(Bitbase::load("no-such-directory"), std::size_t{0},
+               "Missing files are not loaded");
+  auto strongWins = [](std::string_view fen) {
+    bool wins = false;
+    return Bitbase::probe(GameState{fen}, wins) && wins;
+  };
+  assertEquals(strongWins("8/4k3/8/4K3/4P3/8/8/8 b - - 0 1"), true,
+               "The king in front of its pawn wins with the opposition");
+  assertEquals(strongWins("8/4k3/8/4K3/4P3/8/8/8 w - - 0 1"), false,
+               "But not without it");
+  assertEquals(strongWins("k7/8/8/8/8/8/P7/K7 w - - 0 1"), false,
+               "The rook pawn does not win against a king in the corner");
+  assertEquals(strongWins("8/8/8/8/8/8/P6k/K7 w - - 0 1"), true,
+               "A king outside the square of the pawn is too slow");
+  assertEquals(strongWins("8/8/8/4k3/8/8/8/KQ6 w - - 0 1"), true,
+               "King and queen win");
+  assertEquals(strongWins("k7/2Q5/1K6/8/8/8/8/8 b - - 0 1"), false,
+               "Stalemate is a draw");
+  assertEquals(strongWins("8/8/8/8/8/2k5/1Q6/7K b - - 0 1"), false,
+               "An undefended queen is taken");
+  assertEquals(strongWins("r3k3/8/8/8/4K3/8/8/8 b - - 0 1"), true,
+               "Black as the stronger side is mirrored");
+  bool wins = false;
+  assertEquals(Bitbase::probe(GameState{"8/8/8/8/8/8/8/KB5k w - - 0 1"}, wins),
+               false, "Other endgames are not covered");
+  assertEquals(Eval::eval(GameState{"8/8/8/4k3/8/8/8/KQ6 b - - 0 1"}) <
+                   -Eval::knownWin,
+               true, "The evaluation knows won endgames");
+
+  // Each entry must agree with the entries one move later.
+  std::mt19937 generator{42};
+  std::uniform_int_distribution<int> square{0, 63};
+  int checked = 0;
+  int agreed = 0;
+  for (char piece : {'P', 'Q', 'R'}) {
+    while (checked < 200 * (piece == 'P' ? 1 : piece == 'Q' ? 2 : 3)) {
+      std::string board(64, '1');
+      int white = square(generator);
+      int black = square(generator);
+      int other = square(generator);
+      if (white == black || white == other || black == other) continue;
+      if (piece == 'P' && (other < 8 || other >= 56)) continue;
+      board[static_cast<std::size_t>(white)] = 'K';
+      board[static_cast<std::size_t>(black)] = 'k';
+      board[static_cast<std::size_t>(other)] = piece;
+      std::string placement;
+      for (int rank = 7; rank >= 0; rank--) {
+        placement += board.substr(static_cast<std::size_t>(rank * 8), 8);
+        if (rank > 0) placement += '/';
+      }
+      bool whiteToMove = generator() % 2 == 0;
+      // The side that is not to move must not be in check.
+      GameState passed{placement + (whiteToMove ? " b" : " w") + " - - 0 1"};
+      if (passed.isCheck() ||
+          MoveTables::kingMoves(static_cast<Square::t>(white))
+              .isSet(static_cast<Square::t>(black))) {
+        continue;
+      }
+      GameState state{placement + (whiteToMove ? " w" : " b") + " - - 0 1"};
+      bool entry = false;
+      Bitbase::probe(state, entry);
+      checked++;
+      agreed += entry == winsByMoves(state);
+    }
+  }
+  assertEquals(agreed, checked, "Entries agree with the moves");
+}
+
+void selfPlay() {
+  header("Self-Play Data");
+  std::string path = "test-datagen.packed";
+  std::remove(path.c_str());
+  std::stringstream log{};
+  std::uint64_t written =
+      Datagen::run(Datagen::Settings{path, 4, 500, 2, 6, 1}, log);
+  Packed::MappedFile file{};
+  file.open(path);
+  assertEquals(file.size(), static_cast<std::size_t>(written),
+               "All generated positions are written");
+  bool quiet = true;
+  GameState state{};
+  for (const Packed::PackedPosition &position : file) {
+    Packed::unpack(position, state);
+    quiet = quiet && !state.isCheck() &&
+            !state.isCapture(Packed::moveOf(position));
+  }
+  assertEquals(quiet, true, "Only quiet positions are kept");
+  std::remove(path.c_str());
+}
+
+void tuning() {
+  header("Tuning");
+  std::vector<Packed::PackedPosition> positions;
+  for (auto [fen, result] :
+       {std::pair{GameState::startingPosition, Packed::Result::draw},
+        {"4k3/8/8/8/8/8/PPPP4/4K3 w - - 0 1", Packed::Result::whiteWins},
+        {"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R b KQkq - 0 1",
+         Packed::Result::draw},
+        {"4k3/8/8/2q5/8/8/8/R3K3 w - - 0 1", Packed::Result::blackWins}}) {
+    GameState state{fen};
+    int score = Eval::handcrafted(state);
+    positions.push_back(Packed::pack(
+        state, static_cast<std::int16_t>(state.us() == Color::white ? score
+                                                                    : -score),
+        static_cast<Packed::Result::t>(result)));
+  }
+  Tune::Dataset data = Tune::extract(positions.data(), positions.size(), 3);
+  Tune::Weights weights = Tune::current();
+  bool matches = data.size() == positions.size();
+  for (std::size_t i = 0; i < data.size(); i++) {
+    matches = matches && std::abs(Tune::evaluate(data, weights, i) -
+                                  data.scores[i]) < 1e-3;
+  }
+  assertEquals(matches, true, "Features reproduce the handcrafted evaluation");
+  assertEquals(data.starts[1] - data.starts[0], 0u,
+               "Symmetric positions cancel out");
+
+  double scale = Tune::fitScale(data, weights, 2);
+  double before = Tune::error(data, weights, data.results, scale, 2);
+  assertEquals(scale > 0 && before > 0, true, "The scale is fitted");
+  std::stringstream log;
+  Tune::Weights tuned = Tune::optimize(
+      data, weights, data.results, scale,
+      Tune::Settings{"", "", 50, 2, 1.0, 1.0}, log);
+  assertEquals(Tune::error(data, tuned, data.results, scale, 2) < before, true,
+               "Tuning lowers the error");
+  std::stringstream written;
+  Tune::write(weights, written);
+  assertEquals(written.str().find("constexpr PositionTable endGameTable = {") !=
+                   std::string::npos,
+               true, "Tuned tables are written as a header");
+}
+
+int refreshedNetworkEval(GameState state) {
+  state.accumulators.reset();
+  return state.accumulators.evaluate(state);
+}
+
+void neuralNetwork() {
+  header("Neural Network");
+  std::stringstream file;
+  Zobrist::SplitMix random{42};
+  std::size_t weights =
+      NNUE::inputs * NNUE::hidden + NNUE::hidden + 2 * NNUE::hidden + 1;
+  for (std::size_t i = 0; i < weights; i++) {
+    auto weight = static_cast<std::int16_t>(random.next() % 64 - 32);
+    file.put(static_cast<char>(weight & 0xff));
+    file.put(static_cast<char>((weight >> 8) & 0xff));
+  }
+  std::stringstream truncated{file.str().substr(1000)};
+  assertEquals(NNUE::load(truncated), false,
+               "Truncated networks are rejected");
+  assertEquals(NNUE::load(file), true, "Networks can be loaded");
+
+  GameState s{
+      "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1"};
+  int start = s.accumulators.evaluate(s);
+  for (auto m : {"e1g1", "a6e2", "c3e2", "e8c8", "d5e6", "b4b3", "e6f7"}) {
+    s.executeMove(Move{m});
+  }
+  assertEquals(s.accumulators.evaluate(s), refreshedNetworkEval(s),
+               "Accumulators are updated incrementally");
+  s.executeMove(Move{"b3a2"});
+  s.executeMove(Move{"f7f8q"});
+  assertEquals(s.accumulators.evaluate(s), refreshedNetworkEval(s),
+               "Accumulators are updated on promotions");
+  for (int i = 0; i < 9; i++) {
+    s.undoMove();
+  }
+  assertEquals(s.accumulators.evaluate(s), start,
+               "Accumulators are restored by undoing moves");
+  NNUE::unload();
+}
+
 void perft(GameState& start, std::vector<std::uint64_t>& results, int depth) {
   auto moves = start.generateLegalMoves();
 
@@ -301,6 +1237,8 @@ void perftTest() {
       "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
       {48, 2039, 97862, 4085603, 193690690, 8031647685},
       "Kiwipete by Peter McKenzie");
+  assertPerft("8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+              {14, 191, 2812, 43238, 674624, 11030083}, "pos 3");
   assertPerft(
       "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
       {6, 264, 9467, 422333, 15833292, 706045033}, "pos 4");
@@ -320,7 +1258,25 @@ void test() {
   moveClass();
   bitBoards();
   legalMoves();
+  checks();
+  attackMaps();
   makeMove();
+  repetitions();
+  evaluation();
+  pawnStructure();
+  neuralNetwork();
+  uciPositions();
+  searchAndAnalysis();
+  notation();
+  portableGameNotation();
+  matchStatistics();
+  packedPositions();
+  openingBook();
+  tablebases();
+  bitbases();
+  syzygyTables();
+  selfPlay();
+  tuning();
   perftTest();
 
   if (failures == 0) {
@@ -0,0 +1,61 @@
+#ifndef TOKENS_H
+#define TOKENS_H
+
+#include <algorithm>
+#include <string_view>
+
+namespace Dagor {
+
+/// @brief Splits a line into whitespace separated words. The words are views
+/// into the line, so nothing is copied or allocated; the line must outlive
+/// them.
+class Tokenizer {
+ private:
+  std::string_view rest;
+
+  static constexpr std::string_view whitespace = " \t\r\n";
+
+  void skipWhitespace() {
+    std::size_t first = rest.find_first_not_of(whitespace);
+    rest.remove_prefix(first == std::string_view::npos ? rest.size() : first);
+  }
+
+ public:
+  constexpr explicit Tokenizer(std::string_view line) : rest{line} {}
+
+  /// @return the next word, or an empty view at the end of the line.
+  std::string_view next() {
+    skipWhitespace();
+    std::size_t length = std::min(rest.find_first_of(whitespace), rest.size());
+    std::string_view word = rest.substr(0, length);
+    rest.remove_prefix(length);
+    return word;
+  }
+
+  /// @return everything that has not been read yet, without surrounding
+  /// whitespace. Afterwards, the whole line has been read.
+  std::string_view remainder() {
+    skipWhitespace();
+    std::size_t last = rest.find_last_not_of(whitespace);
+    std::string_view words =
+        rest.substr(0, last == std::string_view::npos ? 0 : last + 1);
+    rest = {};
+    return words;
+  }
+
+  bool done() {
+    skipWhitespace();
+    return rest.empty();
+  }
+};
+
+/// @return the part of a line from the start of `first` to the end of
+/// `last`, both of which must be views into that line.
+inline std::string_view span(std::string_view first, std::string_view last) {
+  return {first.data(),
+          static_cast<std::size_t>(last.data() + last.size() - first.data())};
+}
+
+}  // namespace Dagor
+
+#endif
@@ -0,0 +1,404 @@
+#include "tune.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+#include <utility>
+
+#include "eval.h"
+#include "psqt.h"
+#include "psqt_values.h"
+
+namespace Dagor::Tune {
+
+/// @brief How often the error is reported.
+constexpr unsigned reportInterval = 10;
+
+/// @brief Splits `count` items into one contiguous range per thread and calls
+/// `work(thread, begin, end)` for each of them in parallel.
+template <typename Work>
+void inParallel(std::size_t count, unsigned threads, Work work) {
+  threads = std::max(1u, threads);
+  std::size_t chunk = (count + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (unsigned thread = 0; thread < threads; thread++) {
+    std::size_t begin = std::min(count, thread * chunk);
+    std::size_t end = std::min(count, begin + chunk);
+    workers.emplace_back(work, thread, begin, end);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+double sigmoid(double scale, double eval) {
+  return 1 / (1 + std::exp(-scale * eval));
+}
+
+Weights current() {
+  Weights weights(2 * terms);
+  for (std::size_t term = 0; term < worthTerms; term++) {
+    weights[2 * term] = Eval::middleGameTable[term];
+    weights[2 * term + 1] = Eval::endGameTable[term];
+  }
+  for (Piece::t piece : Piece::nonKing) {
+    weights[2 * (worthTerms + piece)] = Eval::middleGameWorth[piece];
+    weights[2 * (worthTerms + piece) + 1] = Eval::endGameWorth[piece];
+  }
+  return weights;
+}
+
+/// @brief Adds the terms of one position, merging those that appear more
+/// than once (e.g. for pawns of both colors on mirrored squares).
+void addTerms(const GameState &state, Dataset &data,
+              std::vector<std::pair<std::uint16_t, int>> &found) {
+  found.clear();
+  for (Square::t square : state.occupancy()) {
+    Piece::t piece = state.getPiece(square);
+    bool white = state.getColor(square) == Color::white;
+    int count = white ? 1 : -1;
+    // Black uses the tables upside down, which they already are.
+    int index = white ? square ^ 56 : square;
+    found.emplace_back(piece * Square::size + index, count);
+    if (piece != Piece::king) found.emplace_back(worthTerms + piece, count);
+  }
+  std::sort(found.begin(), found.end());
+  for (std::size_t i = 0; i < found.size();) {
+    std::uint16_t term = found[i].first;
+    int count = 0;
+    for (; i < found.size() && found[i].first == term; i++) {
+      count += found[i].second;
+    }
+    if (count != 0) {
+      data.terms.push_back(term);
+      data.counts.push_back(static_cast<std::int8_t>(count));
+    }
+  }
+  data.starts.push_back(static_cast<std::uint32_t>(data.terms.size()));
+}
+
+Dataset extract(const Packed::PackedPosition *positions, std::size_t count,
+                unsigned threads) {
+  threads = std::max(1u, threads);
+  std::vector<Dataset> parts(threads);
+  Weights weights = current();
+  inParallel(count, threads, [&](unsigned thread, std::size_t begin,
+                                 std::size_t end) {
+    Dataset &part = parts[thread];
+    GameState state{};
+    std::vector<std::pair<std::uint16_t, int>> found;
+    for (std::size_t i = begin; i < end; i++) {
+      const Packed::PackedPosition &position = positions[i];
+      Packed::unpack(position, state);
+      addTerms(state, part, found);
+      part.phases.push_back(static_cast<float>(
+          std::min(state.phase, Eval::fullPhase)) / Eval::fullPhase);
+      part.rest.push_back(0);
+      part.results.push_back((position.result + 1) / 2.0f);
+      part.scores.push_back(position.score);
+
+      int eval = Eval::handcrafted(state);
+      if (state.us() == Color::black) eval = -eval;
+      std::size_t last = part.size() - 1;
+      part.rest[last] =
+          static_cast<float>(eval - evaluate(part, weights, last));
+    }
+  });
+
+  Dataset data{};
+  for (const Dataset &part : parts) {
+    std::uint32_t offset = data.starts.back();
+    for (std::size_t i = 1; i < part.starts.size(); i++) {
+      data.starts.push_back(offset + part.starts[i]);
+    }
+    data.terms.insert(data.terms.end(), part.terms.begin(), part.terms.end());
+    data.counts.insert(data.counts.end(), part.counts.begin(),
+                       part.counts.end());
+    data.phases.insert(data.phases.end(), part.phases.begin(),
+                       part.phases.end());
+    data.rest.insert(data.rest.end(), part.rest.begin(), part.rest.end());
+    data.results.insert(data.results.end(), part.results.begin(),
+                        part.results.end());
+    data.scores.insert(data.scores.end(), part.scores.begin(),
+                       part.scores.end());
+  }
+  return data;
+}
+
+double evaluate(const Dataset &data, const Weights &weights, std::size_t i) {
+  double middleGame = 0;
+  double endGame = 0;
+  for (std::uint32_t j = data.starts[i]; j < data.starts[i + 1]; j++) {
+    std::size_t term = data.terms[j];
+    middleGame += data.counts[j] * weights[2 * term];
+    endGame += data.counts[j] * weights[2 * term + 1];
+  }
+  double phase = data.phases[i];
+  return middleGame * phase + endGame * (1 - phase) + data.rest[i];
+}
+
+double fitScale(const Dataset &data, const Weights &weights, unsigned threads) {
+  // The evaluations do not depend on the scale, so compute them only once.
+  std::vector<double> evals(data.size());
+  inParallel(data.size(), threads,
+             [&](unsigned, std::size_t begin, std::size_t end) {
+               for (std::size_t i = begin; i < end; i++) {
+                 evals[i] = evaluate(data, weights, i);
+               }
+             });
+  auto errorFor = [&](double scale) {
+    double sum = 0;
+    for (std::size_t i = 0; i < evals.size(); i++) {
+      double difference = sigmoid(scale, evals[i]) - data.results[i];
+      sum += difference * difference;
+    }
+    return sum;
+  };
+
+  // Golden section search, the error has a single minimum in the scale.
+  const double ratio = (std::sqrt(5.0) - 1) / 2;
+  double low = 1e-4;
+  double high = 0.05;
+  for (int i = 0; i < 60; i++) {
+    double left = high - ratio * (high - low);
+    double right = low + ratio * (high - low);
+    if (errorFor(left) < errorFor(right)) {
+      high = right;
+    } else {
+      low = left;
+    }
+  }
+  return (low + high) / 2;
+}
+
+double error(const Dataset &data, const Weights &weights,
+             const std::vector<float> &targets, double scale,
+             unsigned threads) {
+  if (data.size() == 0) return 0;
+  std::vector<double> sums(std::max(1u, threads));
+  inParallel(data.size(), threads,
+             [&](unsigned thread, std::size_t begin, std::size_t end) {
+               double sum = 0;
+               for (std::size_t i = begin; i < end; i++) {
+                 double difference =
+                     sigmoid(scale, evaluate(data, weights, i)) - targets[i];
+                 sum += difference * difference;
+               }
+               sums[thread] = sum;
+             });
+  double sum = 0;
+  for (double part : sums) {
+    sum += part;
+  }
+  return sum / data.size();
+}
+
+/// @brief The gradient of the mean squared error with respect to the
+/// weights. Each thread sums into its own copy, which are added up at the end.
+Weights gradient(const Dataset &data, const Weights &weights,
+                 const std::vector<float> &targets, double scale,
+                 unsigned threads) {
+  threads = std::max(1u, threads);
+  std::vector<Weights> parts(threads, Weights(weights.size()));
+  inParallel(data.size(), threads, [&](unsigned thread, std::size_t begin,
+                                       std::size_t end) {
+    Weights &part = parts[thread];
+    for (std::size_t i = begin; i < end; i++) {
+      double predicted = sigmoid(scale, evaluate(data, weights, i));
+      double slope = 2 * (predicted - targets[i]) * predicted *
+                     (1 - predicted) * scale / data.size();
+      double middleGame = slope * data.phases[i];
+      double endGame = slope * (1 - data.phases[i]);
+      for (std::uint32_t j = data.starts[i]; j < data.starts[i + 1]; j++) {
+        std::size_t term = data.terms[j];
+        part[2 * term] += data.counts[j] * middleGame;
+        part[2 * term + 1] += data.counts[j] * endGame;
+      }
+    }
+  });
+  for (unsigned thread = 1; thread < threads; thread++) {
+    for (std::size_t i = 0; i < weights.size(); i++) {
+      parts[0][i] += parts[thread][i];
+    }
+  }
+  return parts[0];
+}
+
+/// @brief The Adam optimizer, which adapts the step size of every weight to
+/// the size and noise of its gradients. Weights of rare terms (a king on a8
+/// in the middle game) move as fast as those of common ones.
+class Adam {
+ private:
+  static constexpr double beta1 = 0.9;
+  static constexpr double beta2 = 0.999;
+  static constexpr double epsilon = 1e-8;
+
+  double learningRate;
+  Weights momentum;
+  Weights velocity;
+  int steps;
+
+ public:
+  Adam(double learningRate, std::size_t size)
+      : learningRate{learningRate},
+        momentum(size),
+        velocity(size),
+        steps{0} {}
+
+  void step(Weights &weights, const Weights &gradient) {
+    steps++;
+    double correction1 = 1 - std::pow(beta1, steps);
+    double correction2 = 1 - std::pow(beta2, steps);
+    for (std::size_t i = 0; i < weights.size(); i++) {
+      momentum[i] = beta1 * momentum[i] + (1 - beta1) * gradient[i];
+      velocity[i] =
+          beta2 * velocity[i] + (1 - beta2) * gradient[i] * gradient[i];
+      weights[i] -= learningRate * (momentum[i] / correction1) /
+                    (std::sqrt(velocity[i] / correction2) + epsilon);
+    }
+  }
+};
+
+void writeTable(const std::vector<int> &table, std::ostream &out) {
+  constexpr std::array<const char *, Piece::all.size()> names = {
+      "Pawns", "Knights", "Bishops", "Rooks", "Queen", "King"};
+  for (Piece::t piece : Piece::all) {
+    std::vector<std::string> rows;
+    std::size_t width = 0;
+    for (int rank = 0; rank < Coord::width; rank++) {
+      std::ostringstream row;
+      for (int file = 0; file < Coord::width; file++) {
+        row << table[piece * Square::size + rank * Coord::width + file] << ',';
+        if (file + 1 < Coord::width) row << ' ';
+      }
+      rows.push_back(row.str());
+      width = std::max(width, rows.back().size());
+    }
+    if (piece != Piece::pawn) out << '\n';
+    out << "    /* " << names[piece] << " */\n";
+    for (const std::string &row : rows) {
+      out << "    " << std::left << std::setw(static_cast<int>(width) + 2)
+          << row << "//\n";
+    }
+  }
+}
+
+void write(const Weights &weights, std::ostream &out) {
+  std::array<std::vector<int>, 2> tables;
+  std::array<std::array<int, Piece::nonKing.size()>, 2> worth{};
+  for (std::size_t phase = 0; phase < 2; phase++) {
+    tables[phase].resize(worthTerms);
+    for (Piece::t piece : Piece::all) {
+      // Pawns never stand on the first and the last rank.
+      std::size_t first = piece == Piece::pawn ? Coord::width : 0;
+      std::size_t last =
+          piece == Piece::pawn ? Square::size - Coord::width : Square::size;
+      double mean = 0;
+      for (std::size_t index = first; index < last; index++) {
+        mean += weights[2 * (piece * Square::size + index) + phase];
+      }
+      mean /= last - first;
+      for (std::size_t index = 0; index < Square::size; index++) {
+        double value = weights[2 * (piece * Square::size + index) + phase];
+        bool used = first <= index && index < last;
+        tables[phase][piece * Square::size + index] =
+            used ? std::clamp(static_cast<int>(std::lround(value - mean)),
+                              -128, 127)
+                 : 0;
+      }
+      if (piece != Piece::king) {
+        worth[phase][piece] = static_cast<int>(
+            std::lround(weights[2 * (worthTerms + piece) + phase] + mean));
+      }
+    }
+  }
+
+  out << "#ifndef PSQT_VALUES_H\n"
+         "#define PSQT_VALUES_H\n\n"
+         "#include <array>\n"
+         "#include <cstdint>\n\n"
+         "#include \"types.h\"\n\n"
+         "/// @file psqt_values.h\n"
+         "/// The values behind `pieceSquareTable`. `tune` writes a new "
+         "version of this\n"
+         "/// file, so keep it free of anything else.\n\n"
+         "namespace Dagor::Eval {\n\n"
+         "/// @brief The positional bonuses, as seen by white: the first row "
+         "of each\n"
+         "/// table is rank 8, the last one rank 1.\n"
+         "using PositionTable = std::array<std::int8_t, Square::size * "
+         "Piece::all.size()>;\n";
+  constexpr std::array<const char *, 2> phases = {"middleGame", "endGame"};
+  for (std::size_t phase = 0; phase < 2; phase++) {
+    out << (phase == 0 ? "\n" : "")
+        << "constexpr std::array<std::int16_t, Piece::all.size()> "
+        << phases[phase] << "Worth = {\n    ";
+    for (std::size_t piece = 0; piece < worth[phase].size(); piece++) {
+      out << (piece > 0 ? ", " : "") << worth[phase][piece];
+    }
+    out << "};\n";
+  }
+  for (std::size_t phase = 0; phase < 2; phase++) {
+    out << "\nconstexpr PositionTable " << phases[phase] << "Table = {\n";
+    writeTable(tables[phase], out);
+    out << "};\n";
+  }
+  out << "\n}  // namespace Dagor::Eval\n\n#endif\n";
+}
+
+Weights optimize(const Dataset &data, Weights weights,
+                 const std::vector<float> &targets, double scale,
+                 const Settings &settings, std::ostream &out) {
+  auto start = std::chrono::steady_clock::now();
+  Adam optimizer{settings.learningRate, weights.size()};
+  for (unsigned epoch = 1; epoch <= settings.epochs; epoch++) {
+    optimizer.step(weights,
+                   gradient(data, weights, targets, scale, settings.threads));
+    if (epoch % reportInterval == 0 || epoch == settings.epochs) {
+      std::chrono::duration<double> seconds =
+          std::chrono::steady_clock::now() - start;
+      out << "epoch " << epoch << ": error "
+          << error(data, weights, targets, scale, settings.threads) << " ("
+          << seconds.count() << " s)\n";
+      out.flush();
+    }
+  }
+  return weights;
+}
+
+bool run(const Settings &settings, std::ostream &out) {
+  Packed::MappedFile file{};
+  if (!file.open(settings.input)) return false;
+  auto start = std::chrono::steady_clock::now();
+  auto seconds = [&]() {
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+  };
+
+  Dataset data = extract(file.begin(), file.size(), settings.threads);
+  out << "extracted " << data.size() << " positions with "
+      << data.terms.size() << " terms in " << seconds() << " s\n";
+  Weights weights = current();
+  double scale = fitScale(data, weights, settings.threads);
+  std::vector<float> targets(data.size());
+  for (std::size_t i = 0; i < data.size(); i++) {
+    targets[i] = static_cast<float>(
+        settings.resultWeight * data.results[i] +
+        (1 - settings.resultWeight) * sigmoid(scale, data.scores[i]));
+  }
+  out << "scale " << scale << ", error "
+      << error(data, weights, targets, scale, settings.threads) << '\n';
+  out.flush();
+
+  weights = optimize(data, weights, targets, scale, settings, out);
+  std::ofstream output{settings.output};
+  write(weights, output);
+  return static_cast<bool>(output);
+}
+
+}  // namespace Dagor::Tune
@@ -0,0 +1,102 @@
+#ifndef TUNE_H
+#define TUNE_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "packed.h"
+
+/// @brief Fits the material values and piece-square tables to the results of
+/// games (Texel tuning), by gradient descent on the error between the
+/// predicted and the actual outcome of a large set of positions.
+namespace Dagor::Tune {
+
+/// @brief Every tuned value has a middle game and an end game version. Terms
+/// `piece * 64 + index` are the entries of the position tables (in their
+/// rank 8 first order), the last ones the worth of the pieces but the king.
+constexpr std::size_t worthTerms = Square::size * Piece::all.size();
+constexpr std::size_t terms = worthTerms + Piece::nonKing.size();
+
+/// @brief The weights, middle game and end game value of each term next to
+/// each other: `weights[2 * term]` and `weights[2 * term + 1]`.
+using Weights = std::vector<double>;
+
+/// @brief The positions, reduced to what the tuned evaluation depends on and
+/// stored as flat arrays, one pass over which computes all evaluations.
+/// Position `i` has the terms `terms[starts[i]]` to `terms[starts[i + 1]]`,
+/// each counted `counts[...]` times (negative for black pieces).
+struct Dataset {
+  std::vector<std::uint32_t> starts;
+  std::vector<std::uint16_t> terms;
+  std::vector<std::int8_t> counts;
+  /// @brief The share of the middle game value, from 1 in the opening to 0
+  /// with only pawns left.
+  std::vector<float> phases;
+  /// @brief The parts of the handcrafted evaluation that are not tuned here,
+  /// like pawn structure and mobility, from white’s point of view.
+  std::vector<float> rest;
+  /// @brief 1 if white won, 0.5 for a draw and 0 if black won.
+  std::vector<float> results;
+  /// @brief The search scores, from white’s point of view.
+  std::vector<float> scores;
+
+  Dataset()
+      : starts{0}, terms(), counts(), phases(), rest(), results(), scores() {}
+
+  std::size_t size() const { return phases.size(); }
+};
+
+struct Settings {
+  /// @brief A file of packed positions, e.g. from `datagen`.
+  std::string input;
+  /// @brief Where the tuned tables are written to.
+  std::string output;
+  unsigned epochs;
+  unsigned threads;
+  double learningRate;
+  /// @brief How much the targets are the game results rather than the
+  /// search scores.
+  double resultWeight;
+};
+
+/// @return the values the engine is built with.
+Weights current();
+
+/// @brief Precomputes the features of `count` positions on `threads` threads.
+Dataset extract(const Packed::PackedPosition *positions, std::size_t count,
+                unsigned threads);
+
+/// @return the evaluation of position `i` with `weights`, from white’s point
+/// of view.
+double evaluate(const Dataset &data, const Weights &weights, std::size_t i);
+
+/// @return the scale `k` for which `1 / (1 + exp(-k * eval))` predicts the
+/// results best.
+double fitScale(const Dataset &data, const Weights &weights, unsigned threads);
+
+/// @return the mean squared error of the predictions against `targets`.
+double error(const Dataset &data, const Weights &weights,
+             const std::vector<float> &targets, double scale,
+             unsigned threads);
+
+/// @brief Runs `settings.epochs` steps of the Adam optimizer, each over all
+/// positions, starting from `weights`. Progress goes to `out`.
+/// @return the tuned weights.
+Weights optimize(const Dataset &data, Weights weights,
+                 const std::vector<float> &targets, double scale,
+                 const Settings &settings, std::ostream &out);
+
+/// @brief Writes the weights, rounded, as a new `psqt_values.h`. The mean
+/// of each table is moved into the worth of its piece.
+void write(const Weights &weights, std::ostream &out);
+
+/// @brief Loads `settings.input`, fits the scale, optimizes the weights and
+/// writes them to `settings.output`. Progress goes to `out`.
+/// @return `false` if the input could not be read or the output not written.
+bool run(const Settings &settings, std::ostream &out);
+
+}  // namespace Dagor::Tune
+
+#endif
@@ -4,6 +4,7 @@
 #include <array>
 #include <cctype>
 #include <cstdint>
+#include <string>
 
 namespace Dagor {
 
@@ -106,6 +107,33 @@ enum {
 };
 }  // namespace MoveFlags
 
+namespace Score {
+/// @brief A middle game and an end game value packed into a single integer,
+/// so that both can be updated with one addition. The middle game value lives
+/// in the lower 16 bits, the end game value in the upper 16 bits.
+using t = std::int32_t;
+constexpr t zero = 0;
+
+constexpr t make(int middleGame, int endGame) {
+  return static_cast<t>(static_cast<std::uint32_t>(endGame) << 16) +
+         middleGame;
+}
+
+/// @brief Extracts the middle game value of a packed score.
+constexpr int middleGame(t score) {
+  return static_cast<std::int16_t>(
+      static_cast<std::uint16_t>(static_cast<std::uint32_t>(score)));
+}
+
+/// @brief Extracts the end game value of a packed score. The rounding
+/// constant compensates for the borrow a negative middle game value takes from
+/// the upper half.
+constexpr int endGame(t score) {
+  return static_cast<std::int16_t>(static_cast<std::uint16_t>(
+      (static_cast<std::uint32_t>(score) + 0x8000) >> 16));
+}
+}  // namespace Score
+
 namespace Square {
 using t = std::int8_t;
 constexpr t size = Coord::width * Coord::width;
@@ -1,68 +1,514 @@
 #include "uci.h"
 
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
 #include <iostream>
+#include <mutex>
+#include <random>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "bitbase.h"
+#include "book.h"
+#include "eval.h"
 #include "game_state.h"
+#include "nnue.h"
 #include "search.h"
+#include "tablebase.h"
+#include "tokens.h"
 
 namespace Dagor::UCI {
 
 using namespace std::string_view_literals;
 
-std::vector<std::string> splitOnWhitespace(const std::string &input) {
-  std::istringstream stream(input);
-  std::vector<std::string> result;
-  std::string word;
+/// @brief The settings that `setoption` changes, besides the evaluation.
+struct Options {
+  bool ownBook = false;
+  std::string bookFile = "book.bin";
+  Book::Book book{};
+  std::string bitbasePath = ".";
+  int probeLimit = 7;
+  int probeDepth = 1;
+  int multiPv = 1;
+  /// @brief Set by `debug on`: the search statistics follow each search.
+  bool debug = false;
+  /// @brief Set when a network was loaded, so that the search thread
+  /// forgets its cached evaluations before the next search.
+  bool networkChanged = false;
+  /// @brief Set by `ucinewgame`, so that the search thread forgets its
+  /// history before the next search.
+  bool newGame = false;
+};
+
+constexpr int maxMultiPv = 256;
+
+/// @return the number in `value`, clamped into `[low, high]`, or `fallback`
+/// if it is not a number.
+int parseSpin(std::string_view value, int low, int high, int fallback) {
+  int number = fallback;
+  std::from_chars(value.data(), value.data() + value.size(), number);
+  return std::clamp(number, low, high);
+}
+
+/// @brief Opens the book file if the book is to be used, so that missing
+/// files are reported right away and not in the middle of a game.
+void openBook(Options &options, std::ostream &out) {
+  options.book.close();
+  if (!options.ownBook) return;
+  if (options.book.open(options.bookFile)) {
+    out << "info string loaded book " << options.bookFile << " with "
+        << options.book.size() << " entries\n";
+  } else {
+    out << "info string could not load book " << options.bookFile << "\n";
+  }
+}
+
+void setOption(Tokenizer &tokens, GameState &state, Options &options,
+               std::ostream &out) {
+  if (tokens.next() != "name"sv) {
+    return;
+  }
+  std::string_view first = tokens.next();
+  std::string_view last = first;
+  for (auto word = tokens.next(); !word.empty() && word != "value"sv;
+       word = tokens.next()) {
+    last = word;
+  }
+  std::string_view name = span(first, last);
+  std::string_view value = tokens.remainder();
+
+  if (name == "EvalFile"sv) {
+    if (value.empty() || value == "<empty>"sv) {
+      NNUE::unload();
+    } else if (NNUE::load(std::string{value})) {
+      out << "info string loaded network " << value << "\n";
+    } else {
+      out << "info string could not load network " << value
+          << ", using the handcrafted evaluation\n";
+      NNUE::unload();
+    }
+    state.accumulators.reset();
+    options.networkChanged = true;
+  } else if (name == "Ponder"sv) {
+    // The GUI decides when to ponder, there is nothing to set up.
+  } else if (name == "OwnBook"sv) {
+    options.ownBook = value == "true"sv;
+    openBook(options, out);
+  } else if (name == "BookFile"sv) {
+    options.bookFile = value;
+    openBook(options, out);
+  } else if (name == "BitbasePath"sv) {
+    options.bitbasePath = value;
+    out << "info string loaded " << Bitbase::load(options.bitbasePath)
+        << " bitbases from " << value << "\n";
+  } else if (name == "MultiPV"sv) {
+    options.multiPv = parseSpin(value, 1, maxMultiPv, options.multiPv);
+  } else if (name == "SyzygyPath"sv) {
+    if (Tablebase::init(std::string{value})) {
+      out << "info string found tablebases with up to "
+          << Tablebase::largest() << " pieces\n";
+    } else if (!value.empty() && value != "<empty>"sv) {
+      out << "info string found no tablebases in " << value << "\n";
+    }
+  } else if (name == "SyzygyProbeLimit"sv) {
+    options.probeLimit = parseSpin(value, 0, 7, options.probeLimit);
+  } else if (name == "SyzygyProbeDepth"sv) {
+    options.probeDepth =
+        parseSpin(value, 1, Search::maxDepth, options.probeDepth);
+  } else {
+    std::cerr << "discarding unknown option: `" << name << "`\n";
+  }
+}
+
+void setPosition(Tokenizer &tokens, Position &position) {
+  std::string_view kind = tokens.next();
+  std::string_view base = "startpos"sv;
+  std::string_view word = tokens.next();
+  if (kind == "fen"sv) {
+    std::string_view first = word;
+    std::string_view last = word;
+    for (; !word.empty() && word != "moves"sv; word = tokens.next()) {
+      last = word;
+    }
+    base = span(first, last);
+  }
+
+  if (base != position.base) {
+    position.state = base == "startpos"sv ? GameState{} : GameState{base};
+    position.base = base;
+    position.moves.clear();
+  }
+
+  std::size_t ply = 0;
+  for (word = tokens.next(); !word.empty(); word = tokens.next(), ply++) {
+    Move move{word};
+    if (ply < position.moves.size()) {
+      if (position.moves[ply] == move) continue;
+      position.takeBack(ply);
+    }
+    position.state.executeMove(move);
+    position.moves.push_back(move);
+  }
+  position.takeBack(ply);
+}
+
+void setPosition(std::string_view line, Position &position) {
+  Tokenizer tokens{line};
+  tokens.next();
+  setPosition(tokens, position);
+}
+
+/// @brief How much of the remaining time a move may use, if the GUI does not
+/// tell how many moves are left until the next time control.
+constexpr long defaultMovesToGo = 30;
+/// @brief Time kept back for the communication with the GUI.
+constexpr long overhead = 20;
+
+/// @return whether `word` looks like a move in coordinate notation.
+bool isMoveText(std::string_view word) {
+  auto isFile = [](char c) { return c >= 'a' && c <= 'h'; };
+  auto isRank = [](char c) { return c >= '1' && c <= '8'; };
+  return (word.size() == 4 || word.size() == 5) && isFile(word[0]) &&
+         isRank(word[1]) && isFile(word[2]) && isRank(word[3]);
+}
+
+/// @param ponder set if the search is to think on the opponent’s time.
+Search::Limits goLimits(Tokenizer &tokens, Color::t us, bool &ponder) {
+  std::array<long, Color::size> time = {-1, -1};
+  std::array<long, Color::size> increment = {0, 0};
+  long movesToGo = defaultMovesToGo;
+  long moveTime = -1;
+  long depth = 0;
+  long nodes = 0;
+  long mate = 0;
+  std::vector<Move> searchMoves;
+  ponder = false;
+  for (auto word = tokens.next(); !word.empty(); word = tokens.next()) {
+    if (word == "searchmoves"sv) {
+      // The moves run up to the next keyword, if any.
+      for (word = tokens.next(); isMoveText(word); word = tokens.next()) {
+        searchMoves.emplace_back(word);
+      }
+      if (word.empty()) break;
+    }
+    if (word == "ponder"sv) {
+      ponder = true;
+      continue;
+    }
+    std::string_view number = tokens.next();
+    long value = 0;
+    std::from_chars(number.data(), number.data() + number.size(), value);
+    if (word == "wtime"sv) {
+      time[Color::white] = value;
+    } else if (word == "btime"sv) {
+      time[Color::black] = value;
+    } else if (word == "winc"sv) {
+      increment[Color::white] = value;
+    } else if (word == "binc"sv) {
+      increment[Color::black] = value;
+    } else if (word == "movestogo"sv) {
+      movesToGo = std::max(value, 1L);
+    } else if (word == "movetime"sv) {
+      moveTime = value;
+    } else if (word == "depth"sv) {
+      depth = std::clamp(value, 1L, static_cast<long>(Search::maxDepth - 1));
+    } else if (word == "nodes"sv) {
+      nodes = std::max(value, 1L);
+    } else if (word == "mate"sv) {
+      mate = std::clamp(value, 1L, static_cast<long>(Search::maxDepth / 2));
+    }
+  }
+
+  Search::Limits limits{};
+  limits.nodes = static_cast<std::uint64_t>(nodes);
+  limits.mate = static_cast<int>(mate);
+  if (depth > 0) limits.depth = static_cast<int>(depth);
+  if (moveTime < 0 && time[us] >= 0) {
+    long budget = time[us] / movesToGo + increment[us] / 2;
+    moveTime = std::min(budget, time[us] / 2 - overhead);
+  }
+  if (moveTime >= 0) {
+    limits.moveTime = std::chrono::milliseconds{std::max(moveTime, 1L)};
+  } else if (depth == 0 && nodes == 0 && mate == 0) {
+    limits.depth = Search::defaultDepth;
+  }
+  limits.searchMoves = std::move(searchMoves);
+  return limits;
+}
 
-  while (stream >> word) {
-    result.push_back(word);
+/// @brief Writes a search score the UCI way: mates in moves, negative if
+/// the engine is mated, and anything else in centipawns.
+void writeScore(int score, std::ostream &out) {
+  int plies = Search::mate - std::abs(score);
+  if (plies > Search::maxDepth) {
+    out << "cp " << score;
+  } else if (score > 0) {
+    out << "mate " << (plies + 1) / 2;
+  } else {
+    out << "mate " << -(plies + 1) / 2;
   }
+}
 
-  return result;
+/// @brief Reports a completed iteration, one line per principal variation.
+void writeInfo(const Search::Result &result, std::ostream &out) {
+  long long time = result.time.count();
+  std::uint64_t nps =
+      result.nodes * 1000 / static_cast<std::uint64_t>(std::max(time, 1LL));
+  for (std::size_t i = 0; i < result.lines.size(); i++) {
+    const Search::Line &line = result.lines[i];
+    out << "info depth " << result.depth << " seldepth "
+        << result.selectiveDepth;
+    if (result.lines.size() > 1) out << " multipv " << i + 1;
+    out << " score ";
+    writeScore(line.score, out);
+    out << " nodes " << result.nodes << " nps " << nps << " time " << time
+        << " tbhits "
+        << result.statistics.tablebaseHits << " pv";
+    for (Move move : line.pv) {
+      out << ' ' << move;
+    }
+    out << '\n';
+  }
+  out.flush();
 }
 
+/// @brief Runs the searches of a session on a thread of its own, so that
+/// `stop` and `ponderhit` are read while it thinks. The thread lives as long
+/// as the session, which keeps its thread local caches warm from one search
+/// to the next.
+class SearchThread {
+ private:
+  std::ostream &out;
+  /// @brief Held by whoever writes to `out`.
+  std::mutex &output;
+  std::mutex mutex;
+  std::condition_variable changed;
+  bool searching;
+  bool hasJob;
+  bool quitting;
+  GameState state;
+  Search::Limits limits;
+  bool debug;
+  bool clearCache;
+  bool clearHistory;
+  Search::Signals signals;
+  std::thread thread;
+
+  void write(const std::string &text) {
+    std::lock_guard<std::mutex> lock{output};
+    out << text;
+    out.flush();
+  }
+
+  void run() {
+    if (clearCache) Eval::evalCache().clear();
+    if (clearHistory) Search::history().clear();
+    limits.onIteration = [this](const Search::Result &result) {
+      std::ostringstream line;
+      writeInfo(result, line);
+      write(line.str());
+    };
+    limits.signals = &signals;
+    Search::Result result = Search::search(state, limits);
+    Search::printStatistics();
+
+    std::unique_lock<std::mutex> lock{mutex};
+    // A search on the opponent’s time answers only once the opponent moved.
+    changed.wait(lock, [this] { return !signals.ponder || signals.stop; });
+    lock.unlock();
+    std::ostringstream answer;
+    if (debug) Search::writeStatistics(result.statistics, answer);
+    answer << "bestmove " << result.bestMove;
+    if (result.pv.size() > 1) answer << " ponder " << result.pv[1];
+    answer << '\n';
+    write(answer.str());
+  }
+
+  void loop() {
+    std::unique_lock<std::mutex> lock{mutex};
+    while (true) {
+      changed.wait(lock, [this] { return hasJob || quitting; });
+      if (quitting) return;
+      hasJob = false;
+      lock.unlock();
+      run();
+      lock.lock();
+      searching = false;
+      changed.notify_all();
+    }
+  }
+
+ public:
+  SearchThread(std::ostream &out, std::mutex &output)
+      : out(out),
+        output(output),
+        mutex(),
+        changed(),
+        searching{false},
+        hasJob{false},
+        quitting{false},
+        state(),
+        limits(),
+        debug{false},
+        clearCache{false},
+        clearHistory{false},
+        signals(),
+        thread() {
+    thread = std::thread{&SearchThread::loop, this};
+  }
+  SearchThread(const SearchThread &) = delete;
+  SearchThread &operator=(const SearchThread &) = delete;
+
+  ~SearchThread() {
+    stop();
+    wait();
+    {
+      std::lock_guard<std::mutex> lock{mutex};
+      quitting = true;
+    }
+    changed.notify_all();
+    thread.join();
+  }
+
+  /// @brief Searches a copy of `position`; the caller waits for the last
+  /// search to end first.
+  void start(const GameState &position, const Search::Limits &job,
+             bool ponder, const Options &options) {
+    std::lock_guard<std::mutex> lock{mutex};
+    state = position;
+    limits = job;
+    debug = options.debug;
+    clearCache = options.networkChanged;
+    clearHistory = options.newGame;
+    signals.stop = false;
+    signals.ponder = ponder;
+    searching = true;
+    hasJob = true;
+    changed.notify_all();
+  }
+
+  void ponderHit() {
+    std::lock_guard<std::mutex> lock{mutex};
+    signals.ponder = false;
+    changed.notify_all();
+  }
+
+  void stop() {
+    std::lock_guard<std::mutex> lock{mutex};
+    signals.stop = true;
+    changed.notify_all();
+  }
+
+  /// @brief Blocks until the search, if any, has given its answer.
+  void wait() {
+    std::unique_lock<std::mutex> lock{mutex};
+    changed.wait(lock, [this] { return !searching; });
+  }
+};
+
 void universalChessInterface(std::istream &in, std::ostream &out) {
-  GameState state{};
+  // Only humans typing at a terminal need a prompt.
+  bool interactive = &in == &std::cin && isatty(STDIN_FILENO);
+  Position position{};
+  GameState &state = position.state;
+  Options options{};
+  // Mapped if `gen-bitbase` wrote them, KPK is computed otherwise.
+  Bitbase::load(options.bitbasePath);
+  std::mt19937_64 generator{std::random_device{}()};
+  std::mutex output;
+  SearchThread searcher{out, output};
+  std::string line;
   while (true) {
-    std::string line;
+    if (interactive) {
+      std::cerr << "\n\033[1;34m> \033[0m\n";
+    }
+    if (!std::getline(in, line)) {
+      // Let the last search finish, unless it waits for the opponent.
+      searcher.ponderHit();
+      searcher.wait();
+      return;
+    }
+    Tokenizer tokens{line};
+    std::string_view command = tokens.next();
 
-    std::cerr << "\n\033[1;34m> \033[0m\n";
-    std::getline(in, line);
-    std::vector<std::string> parts = splitOnWhitespace(line);
+    if (command == "stop"sv || command == "quit"sv) {
+      searcher.stop();
+    } else if (command == "ponderhit"sv) {
+      searcher.ponderHit();
+    }
+    // Everything else waits until the search has answered.
+    if (command != "isready"sv && command != "stop"sv &&
+        command != "ponderhit"sv && command != "debug"sv) {
+      searcher.wait();
+    }
+    std::lock_guard<std::mutex> lock{output};
 
-    if (parts[0] == "quit") {
+    if (command == "quit"sv) {
       return;
-    } else if (parts[0] == "uci") {
+    } else if (command == "stop"sv || command == "ponderhit"sv) {
+      // Handled above.
+    } else if (command == "uci"sv) {
       out << "id name Dagor-in-Erain\n";
       out << "id author Jakob Teuber\n";
+      out << "option name EvalFile type string default <empty>\n";
+      out << "option name Ponder type check default false\n";
+      out << "option name MultiPV type spin default 1 min 1 max "
+          << maxMultiPv << "\n";
+      out << "option name OwnBook type check default false\n";
+      out << "option name BookFile type string default book.bin\n";
+      out << "option name BitbasePath type string default .\n";
+      out << "option name SyzygyPath type string default <empty>\n";
+      out << "option name SyzygyProbeLimit type spin default 7 min 0 max 7\n";
+      out << "option name SyzygyProbeDepth type spin default 1 min 1 max "
+          << Search::maxDepth << "\n";
       out << "uciok\n";
-    } else if (parts[0] == "isready") {
+    } else if (command == "debug"sv) {
+      options.debug = tokens.next() == "on"sv;
+    } else if (command == "isready"sv) {
       out << "readyok\n";
-    } else if (parts[0] == "ucinewgame") {
-      // nothing
-    } else if (parts[0] == "position") {
-      std::size_t movePos = line.find("moves");
-      if (parts[1] == "startpos") {
-        state = GameState{};
-      } else {
-        std::size_t beginFen = line.find("fen") + 4;
-        state = GameState{line.substr(beginFen, movePos - beginFen)};
+    } else if (command == "setoption"sv) {
+      setOption(tokens, state, options, out);
+    } else if (command == "ucinewgame"sv) {
+      // The next position is set up from scratch, and nothing the search
+      // learned in the last game carries over.
+      position.base.clear();
+      options.newGame = true;
+    } else if (command == "position"sv) {
+      setPosition(tokens, position);
+    } else if (command == "go"sv) {
+      bool ponder = false;
+      Search::Limits limits = goLimits(tokens, state.us(), ponder);
+      // A book move is played at once, but `go ponder` must not be answered
+      // before `ponderhit` or `stop`, so pondering always searches.
+      Move booked = options.ownBook && !ponder
+                        ? options.book.pick(state, generator)
+                        : nullMove;
+      if (!(booked == nullMove)) {
+        out << "bestmove " << booked << "\n";
+        out.flush();
+        continue;
       }
-      if (movePos != std::string::npos) {
-        auto moves = line.substr(movePos + 5);
-        for (auto m : splitOnWhitespace(moves)) {
-          state.executeMove(Move{m});
-        }
-      }
-    } else if (parts[0] == "go") {
-      auto move = Search::search(state);
-      out << "bestmove " << move << "\n";
-    } else {
+      limits.multiPv = options.multiPv;
+      limits.probeLimit = options.probeLimit;
+      limits.probeDepth = options.probeDepth;
+      searcher.start(state, limits, ponder, options);
+      options.networkChanged = false;
+      options.newGame = false;
+    } else if (!command.empty()) {
       std::cerr << "discarding unknown command: `" << line << "`\n";
     }
+    // Answers must not wait in a buffer when the other end is a pipe.
+    out.flush();
   }
 }
 
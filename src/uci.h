@@ -2,10 +2,37 @@
 #define UIC_H
 
 #include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "game_state.h"
+
 namespace Dagor::UCI {
 
+/// @brief The position of the game the GUI is playing, together with how it
+/// was reached. GUIs repeat the whole move list with every `position`
+/// command; when the new list only extends (or shares a prefix with) the
+/// previous one, just the difference is undone and played.
+struct Position {
+  GameState state{};
+  /// @brief `startpos` or the FEN the moves start from.
+  std::string base{};
+  std::vector<Move> moves{};
+
+  /// @brief Takes back all moves after the first `ply` ones.
+  void takeBack(std::size_t ply) {
+    for (; moves.size() > ply; moves.pop_back()) {
+      state.undoMove();
+    }
+  }
+};
+
+/// @brief Brings `position` up to date with a `position ...` command.
+void setPosition(std::string_view line, Position &position);
+
 void universalChessInterface(std::istream &in, std::ostream &out);
 
 }  // namespace Dagor::UCI
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,179 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <array>
+#include <cstdint>
+
+#include "types.h"
+
+namespace Dagor::Zobrist {
+
+/// @brief A small pseudo random number generator (SplitMix64) that can be
+/// evaluated at compile time, so that the keys are the same in every build.
+class SplitMix {
+ private:
+  std::uint64_t state;
+
+ public:
+  constexpr explicit SplitMix(std::uint64_t seed) : state{seed} {}
+
+  constexpr std::uint64_t next() {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+  }
+};
+
+/// @brief One random key for each piece of each color on each square.
+/// Access: `pieceKeys[color][piece][square]`.
+using PieceKeys =
+    std::array<std::array<std::array<std::uint64_t, Square::size>,
+                          Piece::all.size()>,
+               Color::size>;
+
+constexpr PieceKeys generatePieceKeys() {
+  SplitMix random{0x6461676f72};
+  PieceKeys keys{};
+  for (Color::t color : Color::all) {
+    for (Piece::t piece : Piece::all) {
+      for (Square::t square : Square::all) {
+        keys[color][piece][square] = random.next();
+      }
+    }
+  }
+  return keys;
+}
+
+inline constexpr PieceKeys pieceKeys = generatePieceKeys();
+
+/// @brief The keys for everything but the pieces: one for each combination of
+/// castling rights, one for each file of an en passant square and one for
+/// black to move.
+struct StateKeys {
+  std::array<std::uint64_t, CastlingRights::fullRights + 1> castling;
+  std::array<std::uint64_t, Coord::width> enPassant;
+  std::uint64_t blackToMove;
+};
+
+constexpr StateKeys generateStateKeys() {
+  SplitMix random{0x6572e261696e};
+  StateKeys keys{};
+  for (auto &key : keys.castling) {
+    key = random.next();
+  }
+  keys.castling[CastlingRights::none] = 0;
+  for (auto &key : keys.enPassant) {
+    key = random.next();
+  }
+  keys.blackToMove = random.next();
+  return keys;
+}
+
+inline constexpr StateKeys stateKeys = generateStateKeys();
+
+inline std::uint64_t piece(Piece::t piece, Color::t color, Square::t square) {
+  return pieceKeys[color][piece][square];
+}
+
+inline std::uint64_t castling(CastlingRights::t rights) {
+  return stateKeys.castling[rights];
+}
+
+inline std::uint64_t enPassant(Square::t square) {
+  return square == Square::noSquare ? 0
+                                    : stateKeys.enPassant[Square::file(square)];
+}
+
+inline std::uint64_t blackToMove(Color::t next) {
+  return next == Color::black ? stateKeys.blackToMove : 0;
+}
+
+/// @brief The change to the hash of every move of a knight, bishop, rook,
+/// queen or king between two squares (either way, as it does not depend on
+/// the direction), stored by cuckoo hashing: each key sits in one of two
+/// slots. A position whose hash differs from an earlier one by such a key
+/// may be one move away from repeating it.
+struct CuckooTable {
+  static constexpr std::size_t size = 8192;
+  std::array<std::uint64_t, size> keys;
+  std::array<Square::t, size> from;
+  std::array<Square::t, size> to;
+
+  static constexpr std::size_t first(std::uint64_t key) {
+    return key & (size - 1);
+  }
+  static constexpr std::size_t second(std::uint64_t key) {
+    return (key >> 16) & (size - 1);
+  }
+
+  /// @return the slot of `key`, or `size` if it is not in the table.
+  constexpr std::size_t find(std::uint64_t key) const {
+    if (keys[first(key)] == key) return first(key);
+    if (keys[second(key)] == key) return second(key);
+    return size;
+  }
+};
+
+/// @return whether `piece` can move from `a` to `b` on an empty board.
+constexpr bool reaches(Piece::t piece, Square::t a, Square::t b) {
+  int files = Square::file(a) - Square::file(b);
+  int ranks = Square::rank(a) - Square::rank(b);
+  files = files < 0 ? -files : files;
+  ranks = ranks < 0 ? -ranks : ranks;
+  bool diagonal = files == ranks;
+  bool straight = files == 0 || ranks == 0;
+  switch (piece) {
+    case Piece::knight:
+      return files * ranks == 2;
+    case Piece::bishop:
+      return diagonal;
+    case Piece::rook:
+      return straight;
+    case Piece::queen:
+      return diagonal || straight;
+    default:
+      return files <= 1 && ranks <= 1;
+  }
+}
+
+constexpr CuckooTable generateCuckooTable() {
+  CuckooTable table{};
+  for (Color::t color : Color::all) {
+    for (Piece::t piece : {Piece::knight, Piece::bishop, Piece::rook,
+                           Piece::queen, Piece::king}) {
+      for (Square::t a : Square::all) {
+        for (Square::t b : Square::all) {
+          if (b <= a || !reaches(piece, a, b)) continue;
+          std::uint64_t key = pieceKeys[color][piece][a] ^
+                              pieceKeys[color][piece][b] ^
+                              stateKeys.blackToMove;
+          Square::t from = a;
+          Square::t to = b;
+          // Insert, and move whatever was in the slot to its other one.
+          std::size_t slot = CuckooTable::first(key);
+          while (key != 0) {
+            std::uint64_t evictedKey = table.keys[slot];
+            Square::t evictedFrom = table.from[slot];
+            Square::t evictedTo = table.to[slot];
+            table.keys[slot] = key;
+            table.from[slot] = from;
+            table.to[slot] = to;
+            key = evictedKey;
+            from = evictedFrom;
+            to = evictedTo;
+            slot = slot == CuckooTable::first(key) ? CuckooTable::second(key)
+                                                   : CuckooTable::first(key);
+          }
+        }
+      }
+    }
+  }
+  return table;
+}
+
+inline constexpr CuckooTable cuckooTable = generateCuckooTable();
+
+}  // namespace Dagor::Zobrist
+
+#endif